@@ -15,12 +15,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <chrono>
-#include <map>
 #include "GameEntity.hpp"
 #include "HexCoords.hpp"
-#include "SimpleObject.hpp"
+#include "TerrainArray.hpp"
+#include "TerrainGenerator.hpp"
 #include "TileMap.hpp"
+#include "binary.hpp"
 
 class CellState;
 class CellAppearance;
@@ -36,75 +38,284 @@ using Cell = GameEntity<CellState, CellAppearance>;
 /*
 ====================================================================================================
   ~*~ Cell State ~*~
-  Basically, a HexCoords -> TileData map.
+  Basically, a HexCoords -> TileData map, stored as a dense array since cells are rectangles in
+  offset coordinates.
 ==================================================================================================*/
 class CellState {
-    std::unordered_map<HexCoords, TileData> terrain_map;
+    TerrainArray terrain_map;
 
   public:
     CellState(HexCoords tl = HexCoords::from_offset(0, 0),
-              HexCoords br = HexCoords::from_offset(10, 10)) {
-        // at cell creation, randomly initialize terrain
-        for (int x = tl.get_offset().x; x < br.get_offset().x; x++) {
-            for (int y = tl.get_offset().y; y < br.get_offset().y; y++) {
-                // random tile among 7 + forest or not
-                auto coords = HexCoords::from_offset(x, y);
-                auto data = std::make_pair(rand() % 7, rand() % 2);
-                terrain_map.insert(std::make_pair(coords, data));
-            }
+              HexCoords br = HexCoords::from_offset(10, 10),
+              const TerrainGenerator& generator = TerrainGenerator())
+        : terrain_map(tl.get_offset(), br.get_offset()) {
+        generator.fill(terrain_map);
+    }
+
+    /*  Binary format (little-endian):
+        "MHCS" | u16 version | i32 x, y of the top-left tile (offset) | u16 width, height |
+        width * height tiles as (u8 soil type, u8 is not a forest)                          */
+    static const uint16_t format_version = 1;
+    static const size_t header_size = 18;
+
+    static bool check_header(const char* header) {
+        return std::equal(header, header + 4, "MHCS") and
+               binary::read_u16(header + 4) == format_version;
+    }
+
+    static size_t encoded_size(const char* header) {
+        size_t width = binary::read_u16(header + 14), height = binary::read_u16(header + 16);
+        return header_size + 2 * width * height;
+    }
+
+    // checks magic, version and size of an encoded cell state
+    static bool check(const char* data, size_t size) {
+        return size >= header_size and check_header(data) and size == encoded_size(data);
+    }
+
+    // decodes a cell state, data must have passed check()
+    explicit CellState(const char* data)
+        : terrain_map(ivec(binary::read_i32(data + 6), binary::read_i32(data + 10)),
+                      ivec(binary::read_i32(data + 6) + binary::read_u16(data + 14),
+                           binary::read_i32(data + 10) + binary::read_u16(data + 16))) {
+        const char* tile = data + header_size;
+        for (size_t i = 0; i < terrain_map.size(); i++, tile += 2) {
+            terrain_map[i] = TileData(uint8_t(tile[0]), uint8_t(tile[1]));
+        }
+    }
+
+    void encode(string& out) const {
+        out.resize(header_size + 2 * terrain_map.size());
+        char* data = &out[0];
+        std::copy_n("MHCS", 4, data);
+        binary::write_u16(data + 4, format_version);
+        binary::write_i32(data + 6, terrain_map.get_tl().x);
+        binary::write_i32(data + 10, terrain_map.get_tl().y);
+        binary::write_u16(data + 14, uint16_t(terrain_map.get_width()));
+        binary::write_u16(data + 16, uint16_t(terrain_map.get_height()));
+        char* tile = data + header_size;
+        for (size_t i = 0; i < terrain_map.size(); i++, tile += 2) {
+            tile[0] = char(terrain_map[i].first);
+            tile[1] = char(terrain_map[i].second);
+        }
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const CellState& cs) {
+        string data;
+        cs.encode(data);
+        return os.write(data.data(), data.size());
+    }
+
+    // sets failbit (and leaves the state untouched) if the data is invalid
+    friend std::istream& operator>>(std::istream& is, CellState& cs) {
+        string data(header_size, '\0');
+        if (is.read(&data[0], header_size) and check_header(data.data())) {
+            data.resize(encoded_size(data.data()));
+            is.read(&data[header_size], data.size() - header_size);
+        }
+        if (is and check(data.data(), data.size())) {
+            cs = CellState(data.data());
+        } else {
+            is.setstate(std::ios::failbit);
         }
+        return is;
     }
 
-    std::unordered_map<HexCoords, TileData>& get_map() { return terrain_map; }
+    TerrainArray& get_map() { return terrain_map; }
+    const TerrainArray& get_map() const { return terrain_map; }
 
-    // TODO : stream operators
+    TileData get_terrain_at(const HexCoords& coords) const { return terrain_map.at(coords); }
 
-    // TileData get_terrain_at(const HexCoords& coords) const { return terrain_map.at(coords); }
+    size_t memory_usage() const { return terrain_map.memory_usage(); }
 };
 
+/*
+====================================================================================================
+  ~*~ Detail ~*~
+  Level of detail of cells, selected from the scale of the main view (world pixels per screen
+  pixel). Trees and the hex grid are only drawn at full detail.
+==================================================================================================*/
+enum class Detail { full, texture, colour };
+
+inline Detail detail_at_scale(scalar scale) {
+    return scale < 2.5 ? Detail::full : scale < 8 ? Detail::texture : Detail::colour;
+}
+
 /*
 ====================================================================================================
   ~*~ Cell Appearance ~*~
-  A tilemap with the terrain tiles + objects (trees + potentially other things).
+  A tilemap with the terrain tiles + trees, drawn as a single batch of quads sharing the tree
+  texture (one draw call for the terrain, one for the trees).
+  It can also be drawn once into a texture (at full or reduced resolution, see prerender) so that
+  it is then drawn as a single textured quad, until the next update.
+  When zoomed out, the coarsest representation is a single quad of the average colour of the cell.
 ==================================================================================================*/
 class CellAppearance : public GameObject {
-    // storing objects by y coordinate to be able to draw them in order :)
-    struct vec_compare_y {
-        bool operator()(const vec& v1, const vec& v2) { return v1.y < v2.y; }
-    };
-
     CellState& state;
-    std::multimap<vec, GameObject*, vec_compare_y> objects;
     TileMap terrain_tilemap;
 
-    vector<unique_ptr<SimpleObject>> trees;
-    sf::Texture tree_texture;
+    sf::VertexArray tree_quads{sf::Quads};  // sorted by increasing y, to be drawn in order
+    TextureRegion tree;
+    scalar w{144};  // TODO : w
+
+    Detail detail{Detail::full};
+    sf::FloatRect bounds;  // of everything drawn at full detail
+    unique_ptr<sf::RenderTexture> prerendered;
+    scalar prerendered_scale{0};
+    sf::Sprite prerendered_sprite;
+    sf::VertexArray flat{sf::Quads, 4};
+    TilePalette palette;
+    bool upload_pending{true};  // updated since the last upload
+
+    void draw_full(sf::RenderTarget& target, sf::RenderStates states) const {
+        target.draw(terrain_tilemap, states);
+        states.texture = tree.texture.get();
+        target.draw(tree_quads, states);
+    }
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
         states.transform *= getTransform();
-        target.draw(terrain_tilemap, states);
-        for (auto& o : objects) {
-            target.draw(*o.second, states);
+        if (detail == Detail::colour) {
+            target.draw(flat, states);
+        } else if (prerendered) {
+            target.draw(prerendered_sprite, states);
+        } else {
+            draw_full(target, states);
         }
     }
 
+    sf::Vector2u texture_size(scalar scale) const {
+        return sf::Vector2u(bounds.width * scale + 1, bounds.height * scale + 1);
+    }
+
+    void render_texture(scalar scale) {
+        prerendered.reset();
+        if (!fits_texture(scale)) {
+            return;  // keep drawing at full detail
+        }
+        auto size = texture_size(scale);
+        prerendered = make_unique<sf::RenderTexture>();
+        prerendered_scale = scale;
+        if (!prerendered->create(size.x, size.y)) {
+            prerendered.reset();  // keep drawing at full detail
+            return;
+        }
+        prerendered->setSmooth(scale < 1);
+        prerendered->setView(sf::View(bounds));
+        prerendered->clear(sf::Color::Transparent);
+        draw_full(*prerendered, sf::RenderStates::Default);
+        prerendered->display();
+
+        prerendered_sprite.setTexture(prerendered->getTexture(), true);
+        prerendered_sprite.setPosition(bounds.left, bounds.top);
+        prerendered_sprite.setScale(1 / scale, 1 / scale);
+    }
+
+    // the offset rectangle of the cell, in the average colour of its tiles
+    void update_flat() {
+        auto& terrain_map = state.get_map();
+        int r = 0, g = 0, b = 0;
+        for (auto&& tile : terrain_map) {
+            bool forest = tile.second.second == 0;
+            sf::Color c = forest ? palette.forest : palette.soils[tile.second.first];
+            r += c.r;
+            g += c.g;
+            b += c.b;
+        }
+        int n = std::max(int(terrain_map.size()), 1);
+        sf::Color colour(r / n, g / n, b / n);
+
+        ivec tl = terrain_map.get_tl();
+        ivec br = tl + ivec(terrain_map.get_width(), terrain_map.get_height());
+        vec pixel_tl = HexCoords::from_offset(tl).get_pixel(w);
+        vec pixel_br = HexCoords::from_offset(br).get_pixel(w);
+        flat[0] = sf::Vertex(pixel_tl, colour);
+        flat[1] = sf::Vertex(vec(pixel_br.x, pixel_tl.y), colour);
+        flat[2] = sf::Vertex(pixel_br, colour);
+        flat[3] = sf::Vertex(vec(pixel_tl.x, pixel_br.y), colour);
+    }
+
   public:
-    CellAppearance(CellState& state) : state(state) {
-        tree_texture.loadFromFile("png/tree1.png");
+    // only takes already loaded textures so that it can be built outside of the render thread
+    CellAppearance(CellState& state, TextureHandle tileset, TextureRegion tree,
+                   const TilePalette& palette)
+        : state(state), terrain_tilemap(tileset), tree(tree), palette(palette) {
         update();
     }
 
     void update() {
-        auto terrain_map = state.get_map();
-        trees.clear();
-        objects.clear();
-        for (auto&& tile : state.get_map()) {
+        auto& terrain_map = state.get_map();
+
+        // same placement as a SimpleObject with a 0.5 shift
+        vec size(tree.get_size()), tex_tl = tree.get_origin();
+        vec origin(size.x / 2, (size.y / 2) * 1.5f);
+
+        // tiles are stored row by row, so trees come out sorted by y
+        tree_quads.clear();
+        for (auto&& tile : terrain_map) {
             if (tile.second.second == 0) {  // in case of forest, add tree
-                trees.push_back(
-                    make_unique<SimpleObject>(144, tree_texture, tile.first, 0.5));  // TODO : w
-                objects.insert(make_pair(trees.back()->getOrigin(), trees.back().get()));
+                vec tl = tile.first.get_pixel(w) - origin;
+                tree_quads.append(sf::Vertex(tl, tex_tl));
+                tree_quads.append(sf::Vertex(tl + vec(size.x, 0), tex_tl + vec(size.x, 0)));
+                tree_quads.append(sf::Vertex(tl + size, tex_tl + size));
+                tree_quads.append(sf::Vertex(tl + vec(0, size.y), tex_tl + vec(0, size.y)));
             }
         }
         terrain_tilemap.load(terrain_map);
+        update_flat();
+
+        // union of the terrain and tree bounds
+        bounds = terrain_tilemap.get_bounds();
+        if (tree_quads.getVertexCount() > 0) {
+            auto trees = tree_quads.getBounds();
+            scalar left = std::min(bounds.left, trees.left), top = std::min(bounds.top, trees.top);
+            scalar right = std::max(bounds.left + bounds.width, trees.left + trees.width);
+            scalar bottom = std::max(bounds.top + bounds.height, trees.top + trees.height);
+            bounds = sf::FloatRect(left, top, right - left, bottom - top);
+        }
+        prerendered.reset();  // out of date
+        upload_pending = true;
+    }
+
+    // GPU-side part of the appearance, to be called from the render thread after update (does
+    // nothing if there was no update since the last call)
+    void upload() {
+        if (upload_pending) {
+            terrain_tilemap.upload();
+            upload_pending = false;
+        }
+    }
+
+    // at colour detail, the flat quad is drawn even if there is a texture
+    void set_detail(Detail new_detail) { detail = new_detail; }
+
+    // to be called from the render thread; draws the appearance into a texture at the given
+    // resolution (if it is not there already) and returns whether it is now drawn that way
+    bool prerender(scalar scale) {
+        if (!prerendered or prerendered_scale != scale) {
+            render_texture(scale);
+        }
+        return prerendered != nullptr;
+    }
+
+    void release_texture() { prerendered.reset(); }
+
+    bool fits_texture(scalar scale) const {
+        auto size = texture_size(scale);
+        return size.x <= sf::Texture::getMaximumSize() and size.y <= sf::Texture::getMaximumSize();
+    }
+
+    // video memory, estimated for a texture that is not rendered yet
+    size_t texture_bytes(scalar scale) const {
+        auto size = texture_size(scale);
+        return size_t(size.x) * size.y * 4;
+    }
+    size_t get_texture_bytes() const { return prerendered ? texture_bytes(prerendered_scale) : 0; }
+    scalar get_texture_scale() const { return prerendered ? prerendered_scale : 0; }
+
+    // not including the texture, which lives in video memory
+    size_t memory_usage() const {
+        return sizeof(*this) + terrain_tilemap.memory_usage() - sizeof(TileMap) +
+               tree_quads.getVertexCount() * sizeof(sf::Vertex);
     }
 };
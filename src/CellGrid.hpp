@@ -15,41 +15,487 @@
 
 #pragma once
 
+#include <algorithm>
+#include <set>
+#include <sstream>
 #include "Cell.hpp"
+#include "CellStore.hpp"
+#include "LockFreeQueue.hpp"
+#include "OffsetRect.hpp"
+#include "WorkerPool.hpp"
 
 /*
 ====================================================================================================
   ~*~ CellGrid ~*~
+  Cells are built by a pool of worker threads and handed back to the render thread through a
+  lock-free queue. Until it arrives, a requested cell is drawn as a flat placeholder.
+  Resident cells are kept under a memory budget: when it is exceeded, cells outside the viewport
+  (plus a hysteresis margin) first lose their appearance, then are evicted, least recently visible
+  first.
+  Cells are persistent: they are read from the cell store if possible and generated from the world
+  seed otherwise. Only cells that differ from what the generator produces need to be written back
+  when evicted.
+  The camera is tracked (smoothed velocity and zoom rate) so that cells along its predicted
+  trajectory are requested a few frames before they come into view.
+  Visible cells can be drawn from a texture rendered once (see CellAppearance::prerender). These
+  textures are kept under their own video memory budget, released least recently visible first.
+  Zoomed out (Detail::texture) they are rendered at low resolution; at full detail a texture costs
+  as much as the cell's tiles on screen, so those are only made if given a budget of their own.
 ==================================================================================================*/
-class CellGrid : public GameObject, public Component {
+struct PrefetchStats {
+    unsigned requested{0};  // cells requested by the prefetcher
+    unsigned hits{0};       // cells that were resident when they came into view
+    unsigned misses{0};     // cells that were not
+};
+
+class CellGrid : public GameObject, public TerrainSource, public Component {
     int cell_size{20};
+    scalar w{144};
 
-    struct ivec_compare_y {
-        bool operator()(const ivec& v1, const ivec& v2) {
-            return v1.y == v2.y ? v1.x < v2.x : v1.y < v2.y;
-        }
+    struct CellSlot {
+        unique_ptr<Cell> cell;
+        size_t bytes;
+        unsigned last_visible_frame;
+        bool stored;  // can be recovered from the store or the generator
+        size_t texture_bytes{0};
     };
 
-    std::map<ivec, Cell, ivec_compare_y> cells;
+    struct BuiltCell {
+        ivec coords;
+        unique_ptr<Cell> cell;
+        bool stored;
+    };
+
+    using CellMap = std::map<ivec, CellSlot, ivec_compare_y>;
+    CellMap cells;
+    std::set<ivec, ivec_compare_y> pending_cells;  // requested but not built yet
+    sf::VertexArray placeholders{sf::Quads};
+
+    TextureHandle tileset;
+    TextureRegion tree;
+    TilePalette palette;
+    TerrainGenerator generator;
+    Detail detail{Detail::full};
+
+    // prerendered textures, the budget in use depends on the detail (0 disables them)
+    size_t texture_budget, full_texture_budget{0}, texture_usage{0};
+    static constexpr scalar low_resolution = 0.25;  // of textures used at Detail::texture
+    vector<CellMap::iterator> texture_candidates;
+    // smallest reservation that failed since textures that could be released last changed (0 if
+    // none), so that an exhausted budget is not searched again for every visible cell
+    size_t failed_reservation{0};
+
+    size_t memory_budget, memory_usage{0};
+    int margin;  // in cells, around the visible rectangle
+    unsigned frame{0};
+    OffsetRect visible;
+    vector<CellMap::iterator> eviction_candidates;
+
+    // camera tracking, in pixels and seconds
+    int prefetch_frames;
+    unsigned max_prefetch_per_frame{4};  // keeps the workers free for cells that are visible
+    vec camera_center, camera_size, velocity;
+    scalar zoom_rate{0};  // log of the size ratio per second
+    scalar frame_time{1 / 120.f};
+    bool camera_tracked{false};
+    OffsetRect prefetched;  // protected from eviction
+    vector<pair<scalar, ivec>> prefetch_candidates;  // squared distance to the predicted center
+    PrefetchStats prefetch_stats;
+
+    // declared before the workers so that they are joined before these are destroyed
+    CellStore store;
+    LockFreeQueue<BuiltCell> built_cells;
+    WorkerPool workers;
 
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
         states.transform *= getTransform();
-        for (auto& cell : cells) {  // sorted by increasing y
-            cell.second.draw(target);
-            // target.draw(cell.second, states); // TODO update when states in entity
+        target.draw(placeholders, states);
+        for (auto c : visible) {  // by increasing y
+            auto it = cells.find(c.get_offset());
+            if (it != cells.end()) {
+                it->second.cell->draw(target);
+                // target.draw(cell.second, states); // TODO update when states in entity
+            }
+        }
+    }
+
+    void update_placeholders() {
+        placeholders.resize(pending_cells.size() * 4);
+        int i = 0;
+        for (auto& coords : pending_cells) {
+            vec tl = HexCoords::from_offset(coords * cell_size).get_pixel(w);
+            vec br = HexCoords::from_offset((coords + ivec(1, 1)) * cell_size).get_pixel(w);
+            sf::Vertex* quad = &placeholders[i * 4];
+            quad[0].position = tl;
+            quad[1].position = vec(br.x, tl.y);
+            quad[2].position = br;
+            quad[3].position = vec(tl.x, br.y);
+            for (int j = 0; j < 4; j++) {
+                quad[j].color = sf::Color(60, 75, 50);
+            }
+            i++;
         }
     }
 
+    // loads or generates the cell if cell is null, then builds its appearance, on a worker thread
+    void submit(ivec coords, unique_ptr<Cell> cell = nullptr, bool stored = false) {
+        pending_cells.insert(coords);
+        auto tl = coords * cell_size;
+        auto br = tl + cell_size * ivec(1, 1);
+        auto tileset = this->tileset;
+        auto tree = this->tree;
+        auto palette = this->palette;
+        auto holder = std::make_shared<unique_ptr<Cell>>(std::move(cell));  // std::function copies
+        auto generator = this->generator;
+        workers.submit([=]() {
+            auto cell = std::move(*holder);
+            bool cell_stored = stored;
+            if (!cell) {
+                store.read(coords, [&](const char* data, size_t size) {
+                    if (CellState::check(data, size)) {
+                        cell = make_unique<Cell>(data);
+                        cell_stored = true;
+                    }
+                });
+                if (!cell) {
+                    cell = make_unique<Cell>(HexCoords::from_offset(tl),
+                                             HexCoords::from_offset(br), generator);
+                    cell_stored = true;  // can be generated again at will
+                }
+            }
+            cell->enable_appearance(tileset, tree, palette);
+            built_cells.push(BuiltCell{coords, std::move(cell), cell_stored});
+        });
+        update_placeholders();
+    }
+
+    void enforce_budget() {
+        if (memory_usage <= memory_budget) {
+            return;
+        }
+
+        // cells near the viewport are never touched, to avoid evicting/reloading at its edges
+        eviction_candidates.clear();
+        for (auto it = cells.begin(); it != cells.end(); it++) {
+            ivec c = it->first;
+            if ((c.x < visible.tl.x - margin or c.x > visible.br.x + margin or
+                 c.y < visible.tl.y - margin or c.y > visible.br.y + margin) and
+                !prefetched.contains(c)) {
+                eviction_candidates.push_back(it);
+            }
+        }
+        std::sort(eviction_candidates.begin(), eviction_candidates.end(),
+                  [](CellMap::iterator a, CellMap::iterator b) {
+                      return a->second.last_visible_frame < b->second.last_visible_frame;
+                  });
+
+        // first drop appearances (most of the memory), then evict whole cells
+        for (auto it : eviction_candidates) {
+            auto& slot = it->second;
+            if (slot.cell->has_appearance()) {
+                forget_texture(slot);
+                slot.cell->disable_appearance();
+                memory_usage -= slot.bytes;
+                slot.bytes = slot.cell->memory_usage();
+                memory_usage += slot.bytes;
+                if (memory_usage <= memory_budget) {
+                    return;
+                }
+            }
+        }
+        for (auto it : eviction_candidates) {
+            save(it->first, it->second);
+            forget_texture(it->second);
+            memory_usage -= it->second.bytes;
+            cells.erase(it);
+            if (memory_usage <= memory_budget) {
+                return;
+            }
+        }
+    }
+
+    // to be called when the texture goes away with the appearance
+    void forget_texture(CellSlot& slot) {
+        if (slot.texture_bytes > 0) {
+            failed_reservation = 0;
+        }
+        texture_usage -= slot.texture_bytes;
+        slot.texture_bytes = 0;
+    }
+
+    size_t current_texture_budget() const {
+        return detail == Detail::full ? full_texture_budget : texture_budget;
+    }
+
+    // releases textures of cells that are not visible, least recently visible first, until bytes
+    // more fit in the texture budget
+    bool reserve_texture(size_t bytes) {
+        size_t budget = current_texture_budget();
+        if (texture_usage + bytes <= budget) {
+            return true;
+        }
+        if (bytes > budget or (failed_reservation != 0 and bytes >= failed_reservation)) {
+            return false;
+        }
+        texture_candidates.clear();
+        for (auto it = cells.begin(); it != cells.end(); it++) {
+            if (it->second.texture_bytes > 0 and !visible.contains(it->first)) {
+                texture_candidates.push_back(it);
+            }
+        }
+        std::sort(texture_candidates.begin(), texture_candidates.end(),
+                  [](CellMap::iterator a, CellMap::iterator b) {
+                      return a->second.last_visible_frame < b->second.last_visible_frame;
+                  });
+        for (auto it : texture_candidates) {
+            if (texture_usage + bytes <= budget) {
+                break;
+            }
+            it->second.cell->get_appearance().release_texture();
+            forget_texture(it->second);
+        }
+        if (texture_usage + bytes > budget) {
+            if (failed_reservation == 0 or bytes < failed_reservation) {
+                failed_reservation = bytes;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // chooses how a visible cell is drawn; full detail falls back to drawing the tiles when the
+    // budget is exhausted
+    void update_texture(CellSlot& slot) {
+        auto& appearance = slot.cell->get_appearance();
+        appearance.set_detail(detail);
+        // counted again below, an update of the cell drops its texture
+        texture_usage -= slot.texture_bytes;
+        slot.texture_bytes = 0;
+
+        // textures that cannot be created are not attempted, nor reserved for
+        scalar scale = detail == Detail::texture ? low_resolution : 1;
+        if (detail == Detail::colour or current_texture_budget() == 0) {
+            appearance.release_texture();
+        } else if (appearance.get_texture_scale() != scale) {
+            appearance.release_texture();
+            if (appearance.fits_texture(scale) and
+                reserve_texture(appearance.texture_bytes(scale))) {
+                appearance.prerender(scale);
+            }
+        }
+        slot.texture_bytes = appearance.get_texture_bytes();
+        texture_usage += slot.texture_bytes;
+    }
+
+    // encoding is cheap, writing the file is left to the workers
+    void save(ivec coords, CellSlot& slot) {
+        if (!slot.stored) {
+            std::ostringstream os;
+            os << *slot.cell;
+            store.save(coords, os.str());
+            workers.submit([this, coords]() { store.flush(coords); });
+            slot.stored = true;
+        }
+    }
+
+    OffsetRect cells_in(vec tl, vec br) const {
+        return OffsetRect(cell_of(HexCoords::from_pixel(w, tl).get_offset()),
+                          cell_of(HexCoords::from_pixel(w, br).get_offset()));
+    }
+
+    // in pixels
+    vec cell_center(ivec coords) const {
+        return HexCoords::from_offset(coords * cell_size + ivec(cell_size, cell_size) / 2)
+            .get_pixel(w);
+    }
+
+    void prefetch() {
+        scalar lookahead = prefetch_frames * frame_time;
+        vec center = camera_center + velocity * lookahead;
+        // a sudden zoom out should not request the whole world
+        vec size = camera_size * std::min(scalar(exp(zoom_rate * lookahead)), scalar(2));
+
+        // the motion is linear, so the bounding box of the current and predicted views covers
+        // the whole trajectory
+        vec tl = camera_center - camera_size / 2, br = camera_center + camera_size / 2;
+        vec predicted_tl = center - size / 2, predicted_br = center + size / 2;
+        prefetched = cells_in(vec(std::min(tl.x, predicted_tl.x), std::min(tl.y, predicted_tl.y)),
+                              vec(std::max(br.x, predicted_br.x), std::max(br.y, predicted_br.y)));
+
+        // cells closest to where the camera is heading first, in case they are not all requested
+        prefetch_candidates.clear();
+        for (auto c : prefetched) {
+            ivec coords = c.get_offset();
+            if (!visible.contains(coords) and cells.find(coords) == cells.end() and
+                pending_cells.find(coords) == pending_cells.end()) {
+                vec d = cell_center(coords) - center;
+                prefetch_candidates.emplace_back(d.x * d.x + d.y * d.y, coords);
+            }
+        }
+        size_t requested = std::min(prefetch_candidates.size(), size_t(max_prefetch_per_frame));
+        std::partial_sort(prefetch_candidates.begin(), prefetch_candidates.begin() + requested,
+                          prefetch_candidates.end(),
+                          [](const pair<scalar, ivec>& a, const pair<scalar, ivec>& b) {
+                              return a.first < b.first;
+                          });
+        for (size_t i = 0; i < requested; i++) {
+            submit(prefetch_candidates[i].second);
+        }
+        prefetch_stats.requested += requested;
+    }
+
+    void load_resources(ResourceManager* resources) {
+        tileset = resources->get_texture("png/alltiles.png");
+        tree = resources->get_sprite("png/tree1.png");
+        palette = TileMap::palette(*tileset, tree);
+    }
+
   public:
+    CellGrid(uint32_t seed = 0, size_t memory_budget = 64 << 20, int margin = 1,
+             int prefetch_frames = 30, size_t texture_budget = 256 << 20)
+        : generator(seed),
+          texture_budget(texture_budget),
+          memory_budget(memory_budget),
+          margin(margin),
+          prefetch_frames(prefetch_frames) {
+        port("resources", &CellGrid::load_resources);
+    }
+
+    ~CellGrid() {
+        for (auto& cell : cells) {
+            save(cell.first, cell.second);
+        }
+    }
+
+    // cell containing the hex with the given offset coordinates
+    ivec cell_of(ivec offset) const {
+        auto floor = [this](int i) { return i < 0 ? (i + 1) / cell_size - 1 : i / cell_size; };
+        return ivec(floor(offset.x), floor(offset.y));
+    }
+
+    // requests a cell; it is built asynchronously and shows up after a later receive_cells()
     void add_cell(ivec coords) {
-        if (cells.find(coords) == cells.end()) {
-            auto tl = coords * cell_size;
-            auto unit = ivec(1, 1);
-            cells.emplace(std::piecewise_construct, std::forward_as_tuple(coords),
-                          std::forward_as_tuple(HexCoords::from_offset(tl),
-                                                HexCoords::from_offset(tl + cell_size * unit)));
+        if (cells.find(coords) == cells.end() and
+            pending_cells.find(coords) == pending_cells.end()) {
+            submit(coords);
+        }
+    }
+
+    // to be called from the render thread; moves finished cells into the grid
+    void receive_cells() {
+        BuiltCell built;
+        bool received = false;
+        while (built_cells.pop(built)) {
+            pending_cells.erase(built.coords);
+            built.cell->get_appearance().upload();  // GPU work stays on the render thread
+            size_t bytes = built.cell->memory_usage();
+            cells[built.coords] = CellSlot{std::move(built.cell), bytes, frame, built.stored};
+            memory_usage += bytes;
+            received = true;
         }
+        if (received) {
+            update_placeholders();
+        }
+    }
+
+    // to be called once per frame with the main view and the time since the previous frame;
+    // requests the cells the camera is heading to
+    void track_camera(vec center, vec size, scalar dt) {
+        if (camera_tracked and dt > 0) {
+            // exponential moving averages, so that a single jerky frame does not send the
+            // prefetcher across the map
+            scalar alpha = 0.2;
+            velocity = velocity * (1 - alpha) + (center - camera_center) * (alpha / dt);
+            zoom_rate = zoom_rate * (1 - alpha) + log(size.x / camera_size.x) * (alpha / dt);
+            frame_time = frame_time * (1 - alpha) + dt * alpha;
+        }
+        camera_center = center;
+        camera_size = size;
+        camera_tracked = true;
+        prefetch();
     }
 
-    void remove_cell(ivec coords) { cells.erase(coords); }
+    // to be called once per frame with the visible rectangle, in cell coordinates
+    void update_visibility(const OffsetRect& rect) {
+        frame++;
+        for (auto& entered : RectDifference(rect, visible)) {
+            for (auto c : entered) {
+                if (cells.find(c.get_offset()) != cells.end()) {
+                    prefetch_stats.hits++;
+                } else {
+                    prefetch_stats.misses++;
+                }
+            }
+        }
+        if (!(rect == visible)) {
+            failed_reservation = 0;  // other cells can give their texture up
+        }
+        visible = rect;
+
+        for (auto c : rect) {
+            auto it = cells.find(c.get_offset());
+            if (it != cells.end()) {
+                auto& slot = it->second;
+                slot.last_visible_frame = frame;
+                if (!slot.cell->has_appearance()) {  // rebuild it in the background
+                    auto cell = std::move(slot.cell);
+                    bool stored = slot.stored;
+                    memory_usage -= slot.bytes;
+                    cells.erase(it);
+                    submit(c.get_offset(), std::move(cell), stored);
+                } else {
+                    slot.cell->get_appearance().upload();  // if the cell was updated
+                    update_texture(slot);
+                }
+            }
+        }
+        enforce_budget();
+    }
+
+    void remove_cell(ivec coords) {
+        auto it = cells.find(coords);
+        if (it != cells.end()) {
+            save(coords, it->second);
+            forget_texture(it->second);
+            memory_usage -= it->second.bytes;
+            cells.erase(it);
+        }
+    }
+
+    // from resident cells, which may have been edited, or else from the generator (so stored
+    // cells that are not resident are seen as generated)
+    TileData terrain_at(const HexCoords& coords) const override {
+        auto it = cells.find(cell_of(coords.get_offset()));
+        if (it != cells.end()) {
+            auto& terrain = it->second.cell->get_state().get_map();
+            if (terrain.contains(coords)) {
+                return terrain.at(coords);
+            }
+        }
+        return generator.tile(coords);
+    }
+
+    // applied to visible cells by update_visibility
+    void set_detail(Detail new_detail) {
+        if (new_detail != detail) {
+            failed_reservation = 0;
+        }
+        detail = new_detail;
+    }
+
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+    void set_texture_budget(size_t bytes) {
+        texture_budget = bytes;
+        failed_reservation = 0;
+    }
+    // opt-in, full resolution textures of cells under view can take hundreds of MiB
+    void set_full_texture_budget(size_t bytes) {
+        full_texture_budget = bytes;
+        failed_reservation = 0;
+    }
+    size_t get_texture_usage() const { return texture_usage; }
+    void set_prefetch_frames(int frames) { prefetch_frames = frames; }
+    const PrefetchStats& get_prefetch_stats() const { return prefetch_stats; }
+    size_t get_memory_usage() const { return memory_usage; }
+    size_t get_nb_cells() const { return cells.size(); }
 };
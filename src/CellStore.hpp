@@ -0,0 +1,171 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <sys/stat.h>
+#include <iostream>
+#include <mutex>
+#include "RegionFile.hpp"
+#include "globals.hpp"
+
+/*
+====================================================================================================
+  ~*~ CellStore ~*~
+  Disk-backed store of encoded cells, grouped in memory-mapped region files in a world directory.
+  Can be used from several threads: saves are first recorded in memory (so that a load issued
+  right after a save always sees it) and can then be flushed to disk from any thread.
+  At most max_open_regions region files are kept open, least recently used ones being closed
+  first. A region file that is being read or written is not closed (so that there is never more
+  than one RegionFile per file, which would lose appended data), hence the shared pointers.
+==================================================================================================*/
+class CellStore {
+    string directory;
+
+    struct OpenRegion {
+        std::shared_ptr<RegionFile> file;
+        size_t last_use;
+    };
+
+    std::mutex mutex;  // protects the members below (not the region files themselves)
+    std::map<pair<int, int>, string> unflushed;  // saved but not written to disk yet
+    std::map<pair<int, int>, OpenRegion> regions;
+    size_t nb_uses{0};
+    size_t max_open_regions;
+
+    // closes unused regions, least recently used first, until there are at most max_regions
+    // (a region is only used by those who got it through region(), under the mutex)
+    void close_regions(size_t max_regions) {
+        while (regions.size() > max_regions) {
+            auto oldest = regions.end();
+            for (auto it = regions.begin(); it != regions.end(); it++) {
+                if (it->second.file.use_count() == 1 and
+                    (oldest == regions.end() or it->second.last_use < oldest->second.last_use)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == regions.end()) {
+                return;  // all in use
+            }
+            regions.erase(oldest);
+        }
+    }
+
+    // region files are only created to be written to; a region that is not on disk is not kept,
+    // so that it is seen once another thread creates it
+    std::shared_ptr<RegionFile> region(ivec coords, bool create) {
+        ivec r = RegionFile::region_of(coords);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = regions.find(make_pair(r.x, r.y));
+        if (it == regions.end()) {
+            auto file = std::make_shared<RegionFile>(region_path(directory, r), create);
+            if (!file->is_valid()) {
+                return nullptr;
+            }
+            close_regions(max_open_regions - 1);
+            it = regions.emplace(make_pair(r.x, r.y), OpenRegion{file, 0}).first;
+        }
+        it->second.last_use = ++nb_uses;
+        return it->second.file;
+    }
+
+  public:
+    static string region_path(const string& directory, ivec region) {
+        return directory + "/region_" + std::to_string(region.x) + "_" +
+               std::to_string(region.y) + ".bin";
+    }
+
+    CellStore(string directory = "world", size_t max_open_regions = 16)
+        : directory(directory), max_open_regions(std::max<size_t>(max_open_regions, 1)) {
+        mkdir(directory.c_str(), 0755);  // fails harmlessly if it already exists
+    }
+
+    CellStore(const CellStore&) = delete;
+
+    ~CellStore() { flush_all(); }
+
+    // calls f(const char* data, size_t size) on the encoded cell, decoding straight from the
+    // mapped region file when the cell is on disk
+    template <class F>
+    bool read(ivec coords, F&& f) {
+        string data;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = unflushed.find(make_pair(coords.x, coords.y));
+            if (it != unflushed.end()) {
+                data = it->second;
+            }
+        }
+        if (!data.empty()) {
+            f(data.data(), data.size());
+            return true;
+        }
+        auto file = region(coords, false);
+        return file != nullptr and file->read(coords, std::forward<F>(f));
+    }
+
+    void save(ivec coords, string data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unflushed[make_pair(coords.x, coords.y)] = std::move(data);
+    }
+
+    // writes a saved cell to its region file; on failure, the cell stays saved in memory
+    bool flush(ivec coords) {
+        string data;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = unflushed.find(make_pair(coords.x, coords.y));
+            if (it == unflushed.end()) {
+                return true;  // already flushed by someone else
+            }
+            data = it->second;
+        }
+
+        auto file = region(coords, true);
+        if (file == nullptr or !file->write(coords, data)) {
+            std::cerr << "Could not write cell " << coords.x << ", " << coords.y << " to "
+                      << region_path(directory, RegionFile::region_of(coords)) << std::endl;
+            return false;
+        }
+
+        // only forget it if it was not saved again in the meantime
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = unflushed.find(make_pair(coords.x, coords.y));
+        if (it != unflushed.end() and it->second == data) {
+            unflushed.erase(it);
+        }
+        return true;
+    }
+
+    bool flush_all() {
+        vector<ivec> to_flush;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& e : unflushed) {
+                to_flush.emplace_back(e.first.first, e.first.second);
+            }
+        }
+        bool ok = true;
+        for (auto coords : to_flush) {
+            ok = flush(coords) and ok;
+        }
+        return ok;
+    }
+
+    size_t get_nb_open_regions() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return regions.size();
+    }
+};
@@ -0,0 +1,298 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <random>
+#include "FlowField.hpp"
+#include "HexCoords.hpp"
+#include "Pathfinder.hpp"
+#include "ResourceManager.hpp"
+#include "SpriteBatch.hpp"
+#include "View.hpp"
+#include "globals.hpp"
+
+/*
+====================================================================================================
+  ~*~ Crowd ~*~
+  Villagers wandering around their home hex, stored as a structure of arrays and updated in tight
+  loops rather than as one object per villager. Each frame, the quads of the visible villagers are
+  generated in one pass, sorted by y, and handed to the layer as a sprite stream.
+  Move orders follow paths from the pathfinder. Villagers standing on the same hex share a path,
+  and paths are planned within a time budget per frame so that large orders do not stall a frame
+  (a search that does not fit is resumed on the next one); villagers wait until their path is
+  ready. Orders given to villagers spread over more hexes than
+  max_routes rather use a flow field towards the destination, built in a single sweep (under the
+  same time budget), from which each villager reads its next hex when it reaches the previous one.
+==================================================================================================*/
+class Crowd : public SpriteStream, public Component {
+    // one entry per villager
+    vector<scalar> x, y, target_x, target_y, speed;
+    vector<HexCoords> home;
+    vector<uint8_t> look;
+    vector<sf::Color> clothes_colour;
+    vector<uint32_t> route;     // no_route when wandering
+    vector<uint32_t> waypoint;  // next hex of the route
+
+    // routes of the last order, kept from one order to the next
+    static constexpr uint32_t no_route = std::numeric_limits<uint32_t>::max();
+    vector<vector<HexCoords>> routes;
+    vector<HexCoords> route_starts;
+    std::unordered_map<HexCoords, uint32_t> route_of_start;
+    uint32_t nb_routes{0}, nb_planned{0};  // routes below nb_planned are ready
+    bool searching{false};                 // the search for route nb_planned is in progress
+    HexCoords destination;
+    double planning_budget{2};  // in ms per frame
+    Pathfinder* pathfinder{nullptr};
+
+    FlowField field;  // of the last order, if it has more than max_routes routes
+    bool follow_field{false};
+    uint32_t max_routes{16};
+    int field_margin{8};  // around the villagers and the destination, in tiles
+
+    vector<uint32_t> order;  // villagers by increasing y, kept from one frame to the next
+    vector<uint32_t> arrived;
+    vector<sf::Vertex> quads;  // visible villagers, in order, body then clothes
+    vector<scalar> depths;     // one per quad
+
+    vector<TextureRegion> bodies, clothes;  // looks, all in the same (atlas) texture
+    const sf::Texture* texture{nullptr};
+    View* view{nullptr};
+
+    std::mt19937 gen;
+    std::uniform_real_distribution<scalar> uniform{0, 1};
+    scalar w;                                  // of hexes
+    scalar wander_speed{10}, walk_speed{50};  // in px/s
+    scalar margin{100};                        // half the size of a villager, roughly
+
+    // same distribution as HexCoords::random_pixel(w, 0.8), without seeding a generator each time
+    vec random_pixel(HexCoords hex) {
+        scalar aw = hex::sqrt3 * w / 4;
+        scalar r = 0.8 * aw * sqrt(uniform(gen));
+        scalar theta = uniform(gen) * 2 * M_PI;
+        return hex.get_pixel(w) + vec(r * cos(theta), r * sin(theta));
+    }
+
+    void load_resources(ResourceManager* resources) {
+        for (int i = 1; i <= 3; i++) {
+            auto body = resources->get_sprite("png/people" + std::to_string(i) + ".png");
+            auto cloth = resources->get_sprite("png/clothes" + std::to_string(i) + ".png");
+            if (texture == nullptr) {
+                texture = body.texture.get();
+            }
+            if (body.texture.get() == texture and cloth.texture.get() == texture) {
+                bodies.push_back(body);
+                clothes.push_back(cloth);
+            }
+        }
+    }
+
+    void move(scalar dt) {
+        arrived.clear();
+        for (size_t i = 0; i < x.size(); i++) {
+            scalar dx = target_x[i] - x[i], dy = target_y[i] - y[i];
+            scalar distance = sqrt(dx * dx + dy * dy);
+            if (distance > 3) {
+                scalar step = std::min(speed[i] * dt / distance, scalar(1));
+                x[i] += dx * step;
+                y[i] += dy * step;
+            } else {
+                arrived.push_back(i);
+            }
+        }
+
+        for (auto i : arrived) {
+            next_target(i);
+        }
+    }
+
+    void set_target(size_t i, vec target, scalar new_speed) {
+        target_x[i] = target.x;
+        target_y[i] = target.y;
+        speed[i] = new_speed;
+    }
+
+    // next hex of the route (or of the flow field), or somewhere around home once it is over
+    void next_target(size_t i) {
+        if (route[i] != no_route) {
+            if (route[i] >= nb_planned) {
+                return;  // waiting for its route or for the flow field
+            }
+            if (follow_field) {
+                auto here = HexCoords::from_pixel(w, x[i], y[i]);
+                auto next = field.next_step(here);
+                if (next != here) {
+                    set_target(i, random_pixel(next), walk_speed);
+                    return;
+                }
+            } else if (waypoint[i] < routes[route[i]].size()) {
+                set_target(i, random_pixel(routes[route[i]][waypoint[i]++]), walk_speed);
+                return;
+            }
+            route[i] = no_route;
+        }
+        set_target(i, random_pixel(home[i]), wander_speed);
+    }
+
+    void plan_routes() {
+        if (follow_field) {
+            if (nb_planned < nb_routes and pathfinder->extend_flow_field(field, planning_budget)) {
+                nb_planned = nb_routes;
+            }
+            return;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        auto elapsed = [begin]() {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                             begin).count();
+        };
+        // a search that runs out of budget is resumed next frame
+        while (nb_planned < nb_routes and elapsed() < planning_budget) {
+            auto& path = routes[nb_planned];
+            auto start = route_starts[nb_planned];
+            PathStatus status = PathStatus::failed;
+            if (pathfinder != nullptr and
+                (searching or pathfinder->start_path(start, destination))) {
+                status = pathfinder->extend_path(path, planning_budget - elapsed());
+            }
+            searching = status == PathStatus::searching;
+            if (searching) {
+                return;
+            }
+            if (status == PathStatus::failed) {
+                path.assign({start, destination});  // straight line
+            }
+            nb_planned++;
+        }
+    }
+
+    // villagers move little from one frame to the next, so this is about linear
+    void sort() {
+        for (size_t i = 1; i < order.size(); i++) {
+            auto v = order[i];
+            size_t j = i;
+            for (; j > 0 and y[v] < y[order[j - 1]]; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = v;
+        }
+    }
+
+    void add_quad(const TextureRegion& region, vec position, sf::Color colour) {
+        vec size(region.get_size()), tex_tl = region.get_origin();
+        vec tl = position - size / 2;
+        quads.emplace_back(tl, colour, tex_tl);
+        quads.emplace_back(tl + vec(size.x, 0), colour, tex_tl + vec(size.x, 0));
+        quads.emplace_back(tl + size, colour, tex_tl + size);
+        quads.emplace_back(tl + vec(0, size.y), colour, tex_tl + vec(0, size.y));
+        depths.push_back(position.y);
+    }
+
+    void build_quads() {
+        quads.clear();
+        depths.clear();
+        if (bodies.empty() or view == nullptr) {
+            return;
+        }
+        vec center = view->get().getCenter(), size = view->get().getSize();
+        vec tl = center - size / 2 - vec(margin, margin);
+        vec br = center + size / 2 + vec(margin, margin);
+        for (auto i : order) {
+            if (x[i] >= tl.x and x[i] <= br.x and y[i] >= tl.y and y[i] <= br.y) {
+                vec position(x[i], y[i]);
+                add_quad(bodies[look[i]], position, sf::Color(240, 230, 230));
+                add_quad(clothes[look[i]], position, clothes_colour[i]);
+            }
+        }
+    }
+
+  public:
+    Crowd(scalar w, unsigned seed = 0) : gen(seed), w(w) {
+        port("resources", &Crowd::load_resources);
+        port("view", &Crowd::view);
+        port("pathfinder", &Crowd::pathfinder);
+    }
+
+    // a new villager at a random place of its home hex
+    void add(HexCoords hex) {
+        vec position = random_pixel(hex);
+        x.push_back(position.x);
+        y.push_back(position.y);
+        target_x.push_back(position.x);
+        target_y.push_back(position.y);
+        speed.push_back(wander_speed);
+        home.push_back(hex);
+        look.push_back(bodies.empty() ? 0 : gen() % bodies.size());
+        clothes_colour.emplace_back(50 + gen() % 100, 50 + gen() % 100, 150 + gen() % 50);
+        order.push_back(order.size());
+        route.push_back(no_route);
+        waypoint.push_back(0);
+    }
+
+    // every villager walks to the hex, which becomes its home; villagers stop where they are
+    // until their route is planned
+    void go_to(HexCoords hex) {
+        destination = hex;
+        route_of_start.clear();
+        nb_routes = nb_planned = 0;
+        searching = false;
+        ivec tl = hex.get_offset(), br = tl;
+        for (size_t i = 0; i < x.size(); i++) {
+            auto start = HexCoords::from_pixel(w, x[i], y[i]);
+            ivec offset = start.get_offset();
+            tl = ivec(std::min(tl.x, offset.x), std::min(tl.y, offset.y));
+            br = ivec(std::max(br.x, offset.x), std::max(br.y, offset.y));
+            auto it = route_of_start.find(start);
+            if (it == route_of_start.end()) {
+                if (routes.size() == nb_routes) {
+                    routes.emplace_back();
+                    route_starts.emplace_back();
+                }
+                route_starts[nb_routes] = start;
+                it = route_of_start.emplace(start, nb_routes++).first;
+            }
+            route[i] = it->second;
+            waypoint[i] = 1;  // the first hex of the route is the start
+            set_target(i, vec(x[i], y[i]), walk_speed);
+            home[i] = hex;
+        }
+
+        // one sweep instead of many searches
+        ivec border(field_margin, field_margin);
+        OffsetRect area(tl - border, br + border);
+        follow_field = nb_routes > max_routes and pathfinder != nullptr and
+                       pathfinder->start_flow_field(hex, area, field);
+    }
+
+    void animate(scalar dt) {
+        plan_routes();
+        move(dt);
+        sort();
+        build_quads();
+    }
+
+    size_t size() const { return x.size(); }
+    vec get_position(size_t villager) const { return vec(x[villager], y[villager]); }
+    const vector<uint32_t>& get_order() const { return order; }  // by increasing y
+
+    size_t nb_quads() const override { return depths.size(); }
+    scalar get_depth(size_t quad) const override { return depths[quad]; }
+    const sf::Vertex* get_quad(size_t quad) const override { return &quads[quad * 4]; }
+    const sf::Texture* get_texture() const override { return texture; }
+};
+
+constexpr uint32_t Crowd::no_route;
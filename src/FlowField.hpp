@@ -0,0 +1,77 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <limits>
+#include "HexTopology.hpp"
+#include "OffsetRect.hpp"
+
+/*
+====================================================================================================
+  ~*~ FlowField ~*~
+  For every tile of a rectangle, the cost of reaching one target hex and the direction of the next
+  step towards it, so that any number of walkers going to the same place can read their way in
+  constant time. Built by Pathfinder in one sweep, which can be spread over several frames (the
+  field is only meaningful once complete); arrays are kept when the field is built again.
+==================================================================================================*/
+class FlowField {
+    friend class Pathfinder;
+    static constexpr uint8_t no_direction = hex::nb_directions;
+
+    OffsetRect area;
+    HexCoords target;
+    vector<scalar> cost;        // to reach the target, infinite if it cannot be reached
+    vector<uint8_t> direction;  // of the next step, no_direction at the target or if unreachable
+
+    struct Node {
+        scalar cost;
+        uint32_t index;
+        bool operator<(const Node& other) const { return cost > other.cost; }
+    };
+    vector<Node> frontier;  // min-heap of the sweep, empty once complete
+
+    void reset(const OffsetRect& new_area, HexCoords new_target) {
+        area = new_area;
+        target = new_target;
+        cost.assign(area.size(), std::numeric_limits<scalar>::infinity());
+        direction.assign(area.size(), no_direction);
+        frontier.clear();
+    }
+
+  public:
+    const OffsetRect& get_area() const { return area; }
+    HexCoords get_target() const { return target; }
+    bool is_complete() const { return frontier.empty(); }
+
+    bool contains(const HexCoords& coords) const { return area.contains(coords); }
+
+    scalar cost_to_target(const HexCoords& coords) const {
+        return contains(coords) ? cost[area.index(coords.get_offset())]
+                                : std::numeric_limits<scalar>::infinity();
+    }
+
+    // next hex towards the target; coords itself at the target, outside the area, or if the
+    // target cannot be reached from there
+    HexCoords next_step(const HexCoords& coords) const {
+        if (!contains(coords)) {
+            return coords;
+        }
+        uint8_t d = direction[area.index(coords.get_offset())];
+        return d == no_direction ? coords : hex::neighbour(coords, d);
+    }
+};
+
+constexpr uint8_t FlowField::no_direction;
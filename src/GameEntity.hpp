@@ -25,9 +25,13 @@
 ==================================================================================================*/
 template <class State, class Appearance>
 class GameEntity {
-    unique_ptr<Appearance> appearance;  // should provide Appearance(State&), update(), layer(str)
+    unique_ptr<Appearance> appearance;  // should provide Appearance(State&, ...), update(), layer()
     State state;                        // should provide stream operators, update(...)
 
+    // appearances that need more than the state (e.g., resources) are enabled by the owner
+    void enable_default_appearance(std::true_type) { enable_appearance(); }
+    void enable_default_appearance(std::false_type) {}
+
     friend std::ostream& operator<<(std::ostream& os, const GameEntity<State, Appearance>& ge) {
         os << ge.state;
         return os;
@@ -35,37 +39,47 @@ class GameEntity {
 
     friend std::istream& operator>>(std::istream& is, GameEntity<State, Appearance>& ge) {
         is >> ge.state;
-        ge.appearance->update();
+        if (ge.appearance) ge.appearance->update();
         return is;
     }
 
   public:
     template <class... Args>
     GameEntity(Args&&... args) : state(std::forward<Args>(args)...) {
-        enable_appearance();
+        enable_default_appearance(std::is_constructible<Appearance, State&>());
     }
 
-    // drawable part can be disabled at anytime to free memory
-    // (TODO: should appearance presence be checked when used?)
-    void enable_appearance() { appearance = make_unique<Appearance>(state); }
+    // drawable part can be disabled at anytime to free memory; a disabled entity is not drawn
+    template <class... Args>
+    void enable_appearance(Args&&... args) {
+        appearance = make_unique<Appearance>(state, std::forward<Args>(args)...);
+    }
     void disable_appearance() { appearance.reset(nullptr); }
+    bool has_appearance() const { return appearance != nullptr; }
+
+    // requires State and Appearance to provide memory_usage()
+    size_t memory_usage() const {
+        return sizeof(*this) + state.memory_usage() +
+               (appearance ? appearance->memory_usage() : 0);
+    }
 
     template <class... Args>
     void update(Args&&... args) {
         state.update(std::forward<Args>(args)...);
-        appearance->update();
+        if (appearance) appearance->update();
     }
 
     template <class RenderTarget>  // TODO render states
     void draw(RenderTarget& t) const {
-        t.draw(*appearance);
+        if (appearance) t.draw(*appearance);
     }
 
     template <class RenderTarget>  // TODO render states
     void draw(RenderTarget& t, const string& layer) const {
-        t.draw(appearance->layer(layer));
+        if (appearance) t.draw(appearance->layer(layer));
     }
 
     // State& get_state() { return state; }
-    // Appearance& get_appearance() { return appearance; }
+    const State& get_state() const { return state; }
+    Appearance& get_appearance() { return *appearance; }
 };
@@ -0,0 +1,127 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include "HexCoords.hpp"
+#include "simd.hpp"
+
+/*
+====================================================================================================
+  ~*~ HexBatch ~*~
+  Conversions between hexes and pixels for whole arrays at once, with the same SIMD lanes as the
+  terrain generator (see simd.hpp). Results are exactly those of HexCoords::get_pixel and
+  from_pixel, which perform the same operations.
+==================================================================================================*/
+namespace hex_batch {
+    SIMD_LANES_BEGIN
+    // centers of hexes, by batches of L::width; returns the number done
+    template <class L>
+    SIMD_INLINE size_t to_pixels(scalar w, const HexCoords* in, size_t n, vec* out) {
+        using F = typename L::F;
+        using I = typename L::I;
+        F fw = L::splat(w), fh = L::splat(w * hex::row_height);
+
+        size_t i = 0;
+        for (; i + L::width <= n; i += L::width) {
+            I x, y;
+            for (int lane = 0; lane < L::width; lane++) {
+                ivec axial = in[i + lane].get_axial();
+                L::set_lane(x, lane, axial.x);
+                L::set_lane(y, lane, axial.y);
+            }
+            F fy = L::to_float(y);
+            F px = (L::to_float(x) + fy * 0.5f) * fw, py = fy * fh;
+            for (int lane = 0; lane < L::width; lane++) {
+                out[i + lane] = vec(L::lane(px, lane), L::lane(py, lane));
+            }
+        }
+        return i;
+    }
+
+    // hexes containing pixels, by batches of L::width; returns the number done
+    template <class L>
+    SIMD_INLINE size_t from_pixels(scalar w, const vec* in, size_t n, HexCoords* out) {
+        using F = typename L::F;
+        using I = typename L::I;
+        F inv_w = L::splat(1 / w);
+
+        size_t i = 0;
+        for (; i + L::width <= n; i += L::width) {
+            F x, y;
+            for (int lane = 0; lane < L::width; lane++) {
+                L::set_lane(x, lane, in[i + lane].x);
+                L::set_lane(y, lane, in[i + lane].y);
+            }
+
+            // fractional cube coordinates, rounded; the component with the largest rounding
+            // error is then recomputed from the two others
+            F fx = (x - y * hex::inv_sqrt3) * inv_w, fy = y * (2 * hex::inv_sqrt3) * inv_w;
+            F fz = -fx - fy;
+            I rx = L::round(fx), ry = L::round(fy), rz = L::round(fz);
+            F dx = L::abs(fx - L::to_float(rx)), dy = L::abs(fy - L::to_float(ry));
+            F dz = L::abs(fz - L::to_float(rz));
+            I x_worst = L::greater_mask(dx, dy) & L::greater_mask(dx, dz);
+            I y_worst = ~x_worst & L::greater_mask(dy, dz);
+            I qx = L::select(x_worst, -ry - rz, rx), qy = L::select(y_worst, -rx - rz, ry);
+
+            for (int lane = 0; lane < L::width; lane++) {
+                out[i + lane] = HexCoords::from_axial(L::lane(qx, lane), L::lane(qy, lane));
+            }
+        }
+        return i;
+    }
+    SIMD_LANES_END
+
+#if SIMD_HAS_AVX2
+    SIMD_TARGET_AVX2 inline size_t to_pixels_avx2(scalar w, const HexCoords* in, size_t n,
+                                                  vec* out) {
+        return to_pixels<simd::Vector8>(w, in, n, out);
+    }
+
+    SIMD_TARGET_AVX2 inline size_t from_pixels_avx2(scalar w, const vec* in, size_t n,
+                                                    HexCoords* out) {
+        return from_pixels<simd::Vector8>(w, in, n, out);
+    }
+#endif
+
+    inline void to_pixels(scalar w, const HexCoords* in, size_t n, vec* out,
+                          simd::Level level = simd::best_level()) {
+        size_t done = 0;
+#if SIMD_HAS_AVX2
+        if (level == simd::Level::vector8) {
+            done = to_pixels_avx2(w, in, n, out);
+        }
+#endif
+        if (level != simd::Level::scalar) {
+            done += to_pixels<simd::Vector4>(w, in + done, n - done, out + done);
+        }
+        to_pixels<simd::Scalar>(w, in + done, n - done, out + done);
+    }
+
+    inline void from_pixels(scalar w, const vec* in, size_t n, HexCoords* out,
+                            simd::Level level = simd::best_level()) {
+        size_t done = 0;
+#if SIMD_HAS_AVX2
+        if (level == simd::Level::vector8) {
+            done = from_pixels_avx2(w, in, n, out);
+        }
+#endif
+        if (level != simd::Level::scalar) {
+            done += from_pixels<simd::Vector4>(w, in + done, n - done, out + done);
+        }
+        from_pixels<simd::Scalar>(w, in + done, n - done, out + done);
+    }
+}  // namespace hex_batch
@@ -15,37 +15,60 @@
 
 #pragma once
 
+#include <cstdint>
 #include "globals.hpp"
 
+/*
+====================================================================================================
+  ~*~ constants ~*~
+  Trigonometric factors of (pointy-top) hexagons, known at compile time.
+==================================================================================================*/
+namespace hex {
+    constexpr scalar sqrt3 = 1.7320508f;
+    constexpr scalar inv_sqrt3 = 1 / sqrt3;
+    constexpr scalar row_height = sqrt3 / 2;  // vertical distance between rows, for w = 1
+}  // namespace hex
+
 /*
 ====================================================================================================
   ~*~ HexCoords class ~*~
+  Stored as axial coordinates only (8 bytes), the third cube coordinate being -x - y.
 ==================================================================================================*/
 class HexCoords {
-    int x{0}, y{0}, z{0};
+    int x{0}, y{0};
     friend std::hash<HexCoords>;
 
   public:
-    HexCoords() = default;
-    HexCoords(const HexCoords&) = default;
-    HexCoords(int x, int y, int z) : x(x), y(y), z(z) {}
-    HexCoords(cube c) : x(c.x), y(c.y), z(c.z) {}
+    constexpr HexCoords() = default;
+    constexpr HexCoords(const HexCoords&) = default;
+    constexpr HexCoords(int x, int y, int) : x(x), y(y) {}  // cube coordinates
+    HexCoords(cube c) : x(c.x), y(c.y) {}
 
     ivec get_axial() const { return ivec(x, y); }
-    cube get_cube() const { return cube(x, y, z); }
-    vec get_pixel(int w) const { return vec((x + scalar(y) / 2) * w, scalar(y) * w * sqrt(3) / 2); }
+    cube get_cube() const { return cube(x, y, -x - y); }
+    vec get_pixel(int w) const {
+        return vec((x + scalar(y) * 0.5f) * w, scalar(y) * (w * hex::row_height));
+    }
     ivec get_offset() const { return ivec(get_axial().x + (get_axial().y >> 1), get_axial().y); }
 
     static HexCoords from_axial(ivec v) { return HexCoords(v.x, v.y, -v.x - v.y); }
-    static HexCoords from_axial(int x, int y) { return HexCoords(x, y, -x - y); }
-    static HexCoords from_offset(int x, int y) { return HexCoords::from_axial(x - (y >> 1), y); }
+    static constexpr HexCoords from_axial(int x, int y) { return HexCoords(x, y, -x - y); }
+    static constexpr HexCoords from_offset(int x, int y) {
+        return HexCoords::from_axial(x - (y >> 1), y);
+    }
     static HexCoords from_offset(ivec v) { return HexCoords::from_offset(v.x, v.y); }
     static HexCoords from_cube(cube c) { return HexCoords(c); }
-    static HexCoords from_cube(int x, int y, int z) { return HexCoords(x, y, z); }
+    static constexpr HexCoords from_cube(int x, int y, int z) { return HexCoords(x, y, z); }
     static HexCoords from_pixel(scalar w, vec v) { return from_pixel(w, v.x, v.y); }
     static HexCoords from_pixel(scalar w, scalar x, scalar y) {
-        scalar fx((x - y / sqrt(3)) / w), fy(y * 2 / (sqrt(3) * w)), fz(-fx - fy);
-        scalar rx(round(fx)), ry(round(fy)), rz(round(fz));
+        // same operations as hex_batch::from_pixels
+        scalar inv_w = 1 / w;
+        return from_fractional((x - y * hex::inv_sqrt3) * inv_w, y * (2 * hex::inv_sqrt3) * inv_w);
+    }
+    // rounds fractional axial coordinates to the nearest hex
+    static HexCoords from_fractional(scalar fx, scalar fy) {
+        scalar fz(-fx - fy);
+        scalar rx(floor(fx + 0.5f)), ry(floor(fy + 0.5f)), rz(floor(fz + 0.5f));
         scalar dx(abs(fx - rx)), dy(abs(fy - ry)), dz(abs(fz - rz));
         if (dx > dy and dx > dz) {
             return HexCoords(-ry - rz, ry, rz);
@@ -61,16 +84,34 @@ class HexCoords {
         std::mt19937 gen(rd());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        scalar aw = sqrt(3) * w / 4.0;  // adjusted w
+        scalar aw = hex::sqrt3 * w / 4;  // adjusted w
         scalar r = dis(gen) * aw * aw;
         scalar theta = dis(gen) * 2 * M_PI;
         vec center = get_pixel(w);
         return center + vec(tuning * sqrt(r) * cos(theta), tuning * sqrt(r) * sin(theta));
     }
 
-    bool operator==(const HexCoords& other) const {
-        return x == other.x && y == other.y && z == other.z;
+    constexpr bool operator==(const HexCoords& other) const {
+        return x == other.x && y == other.y;
     }
+    constexpr bool operator!=(const HexCoords& other) const { return !(*this == other); }
+
+    constexpr HexCoords operator+(const HexCoords& other) const {
+        return from_axial(x + other.x, y + other.y);
+    }
+    constexpr HexCoords operator-(const HexCoords& other) const {
+        return from_axial(x - other.x, y - other.y);
+    }
+    constexpr HexCoords operator*(int k) const { return from_axial(k * x, k * y); }
+
+    // number of steps between two hexes
+    constexpr int distance(const HexCoords& other) const {
+        int dx = x - other.x, dy = y - other.y, dz = -dx - dy;
+        return ((dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy) + (dz < 0 ? -dz : dz)) / 2;
+    }
+
+    // both coordinates packed in one integer, e.g. to be used as a key
+    constexpr uint64_t get_key() const { return uint64_t(uint32_t(x)) << 32 | uint32_t(y); }
 };
 
 /*
@@ -87,14 +128,14 @@ std::ostream& operator<<(std::ostream& os, HexCoords c) {
   ~*~ hash ~*~
 ==================================================================================================*/
 namespace std {
+    // splitmix64 finalizer, so that neighbouring hexes end up far apart in hash tables
     template <>
     struct hash<HexCoords> {
-        size_t operator()(const HexCoords& key) const {
-            size_t result = 17;
-            result = result * 79 + hash<int>()(key.x);
-            result = result * 79 + hash<int>()(key.y);
-            result = result * 79 + hash<int>()(key.z);
-            return result;
+        constexpr size_t operator()(const HexCoords& coords) const {
+            uint64_t h = coords.get_key();
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+            return size_t(h ^ (h >> 31));
         }
     };
 }  // namespace std
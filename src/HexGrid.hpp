@@ -15,48 +15,145 @@
 
 #pragma once
 
+#include "HexBatch.hpp"
 #include "HexCoords.hpp"
+#include "OffsetRect.hpp"
 
 /*
 ====================================================================================================
   ~*~ HexGrid ~*~
+  Grid overlay drawn as one batch of quads (a thin hexagonal ring per hex), plus the cursor
+  highlight in its own tiny batch so that moving the cursor does not rebuild the grid.
+  Hexes are stored in a toroidal array of slots indexed by offset coordinates modulo its
+  dimensions, so that panning only rewrites the slots of the hexes that entered the view.
 ==================================================================================================*/
 class HexGrid : public GameObject, public Component {
-    vector<sf::CircleShape> hexes;
+    sf::VertexArray grid{sf::Quads};
+    sf::VertexArray cursor{sf::TriangleFan};
+
+    scalar thickness{3};
+
+    // slots
+    int capacity_x{0}, capacity_y{0};
+    OffsetRect shown;
+    vec inner[6], outer[6];
+    float grid_w{0};
+    vector<HexCoords> hexes;  // reused by write_rect
+    vector<vec> centers;
 
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
         states.transform *= getTransform();
-        for (auto& hex : hexes) {
-            target.draw(hex, states);
+        target.draw(cursor, states);
+        target.draw(grid, states);
+    }
+
+    // corner k of a pointy-top hexagon of circumradius r (same corners as sf::CircleShape(r, 6))
+    static vec corner(scalar r, int k) {
+        scalar angle = k * M_PI / 3 - M_PI / 2;
+        return vec(r * cos(angle), r * sin(angle));
+    }
+
+    // same size as the previous per-hex shapes: a slightly smaller hexagon and its outline
+    scalar inner_radius(float w) const { return w * hex::inv_sqrt3 - thickness; }
+
+    static int modulo(int i, int n) { return ((i % n) + n) % n; }
+
+    size_t slot(ivec offset) const {
+        return (modulo(offset.y, capacity_y) * capacity_x + modulo(offset.x, capacity_x)) * 24;
+    }
+
+    // ring between the hexagon and its outline (outline corners are pushed out so that edges
+    // move by exactly thickness)
+    void write_hex(HexCoords coords, vec center) {
+        sf::Color color(255, 255, 255, 15);
+        size_t i = slot(coords.get_offset());
+        for (int k = 0; k < 6; k++) {
+            int next = (k + 1) % 6;
+            grid[i++] = sf::Vertex(center + inner[k], color);
+            grid[i++] = sf::Vertex(center + outer[k], color);
+            grid[i++] = sf::Vertex(center + outer[next], color);
+            grid[i++] = sf::Vertex(center + inner[next], color);
+        }
+    }
+
+    // centers are computed in one batch
+    void write_rect(const OffsetRect& rect) {
+        hexes.clear();
+        for (auto c : rect) {
+            hexes.push_back(c);
+        }
+        centers.resize(hexes.size());
+        hex_batch::to_pixels(grid_w, hexes.data(), hexes.size(), centers.data());
+        for (size_t i = 0; i < hexes.size(); i++) {
+            write_hex(hexes[i], centers[i]);
+        }
+    }
+
+    // degenerate quads are not rasterized
+    void clear_hex(HexCoords coords) {
+        size_t i = slot(coords.get_offset());
+        for (int k = 0; k < 24; k++) {
+            grid[i + k] = sf::Vertex();
         }
     }
 
   public:
     void highlight(float w, HexCoords coords) {
-        hexes.emplace_back(w / sqrt(3) - 3, 6);
-        auto& hex = hexes.back();
-        hex.setOrigin(hex.getRadius(), hex.getRadius());
-        hex.setPosition(coords.get_pixel(w));
-        hex.setFillColor(sf::Color(255, 0, 0, 15));
+        vec center = coords.get_pixel(w);
+        sf::Color color(255, 0, 0, 15);
+        cursor.clear();
+        cursor.append(sf::Vertex(center, color));
+        for (int k = 0; k <= 6; k++) {
+            cursor.append(sf::Vertex(center + corner(inner_radius(w), k % 6), color));
+        }
     }
 
-    void load(float w, vector<HexCoords> coords, HexCoords cursor = HexCoords(0, 0, 0),
-              bool toggle_grid = true) {
-        hexes.clear();
+    // rebuilds the whole grid for the given rectangle
+    void load(float w, const OffsetRect& rect, bool toggle_grid = true) {
+        grid.clear();
+        shown = OffsetRect();
+        if (!toggle_grid) {
+            return;
+        }
+
+        grid_w = w;
+        scalar r = inner_radius(w), outer_r = r + thickness * 2 * hex::inv_sqrt3;
+        for (int k = 0; k < 6; k++) {
+            inner[k] = corner(r, k);
+            outer[k] = corner(outer_r, k);
+        }
 
-        highlight(w, cursor);
-
-        // rest of the grid
-        if (toggle_grid) {
-            for (auto c : coords) {
-                hexes.emplace_back(w / sqrt(3) - 3, 6);
-                auto& hex = hexes.back();
-                hex.setOrigin(hex.getRadius(), hex.getRadius());
-                hex.setFillColor(sf::Color(0, 0, 0, 0));
-                hex.setPosition(c.get_pixel(w));
-                hex.setOutlineColor(sf::Color(255, 255, 255, 15));
-                hex.setOutlineThickness(3);
+        // some slack so that small zooms do not trigger a rebuild
+        capacity_x = rect.width() + 4;
+        capacity_y = rect.height() + 4;
+        grid.resize(capacity_x * capacity_y * 24);
+        write_rect(rect);
+        shown = rect;
+    }
+
+    // updates the grid with the hexes that entered and exited the view
+    void load(float w, const ViewDiff& diff, bool toggle_grid = true) {
+        if (!toggle_grid) {
+            if (grid.getVertexCount() > 0) {
+                load(w, diff.current, false);
             }
+            return;
+        }
+        if (w != grid_w or shown != diff.previous or diff.current.width() > capacity_x or
+            diff.current.height() > capacity_y) {
+            load(w, diff.current, true);
+            return;
+        }
+
+        // exited first, as an entering hex may reuse the slot of an exiting one
+        for (auto& rect : diff.exited()) {
+            for (auto c : rect) {
+                clear_hex(c);
+            }
+        }
+        for (auto& rect : diff.entered()) {
+            write_rect(rect);
         }
+        shown = diff.current;
     }
 };
@@ -0,0 +1,169 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include "HexCoords.hpp"
+
+/*
+====================================================================================================
+  ~*~ directions ~*~
+  The six axial directions, counter-clockwise starting east.
+==================================================================================================*/
+namespace hex {
+    constexpr int nb_directions = 6;
+
+    constexpr int directions[nb_directions][2] = {{1, 0},  {1, -1}, {0, -1},
+                                                  {-1, 0}, {-1, 1}, {0, 1}};
+
+    constexpr HexCoords direction(int d) {
+        return HexCoords::from_axial(directions[d][0], directions[d][1]);
+    }
+
+    constexpr HexCoords neighbour(const HexCoords& h, int d) { return h + direction(d); }
+}  // namespace hex
+
+/*
+====================================================================================================
+  ~*~ Neighbours ~*~
+  The six hexes adjacent to a center, e.g. for (auto n : Neighbours(h)) {...}.
+==================================================================================================*/
+class Neighbours {
+    HexCoords center;
+
+  public:
+    class iterator {
+        HexCoords center;
+        int d;
+
+      public:
+        constexpr iterator(HexCoords center, int d) : center(center), d(d) {}
+        constexpr HexCoords operator*() const { return hex::neighbour(center, d); }
+        constexpr iterator& operator++() {
+            d++;
+            return *this;
+        }
+        constexpr bool operator==(const iterator& other) const { return d == other.d; }
+        constexpr bool operator!=(const iterator& other) const { return d != other.d; }
+    };
+
+    explicit constexpr Neighbours(HexCoords center) : center(center) {}
+    constexpr iterator begin() const { return iterator(center, 0); }
+    constexpr iterator end() const { return iterator(center, hex::nb_directions); }
+    constexpr int size() const { return hex::nb_directions; }
+};
+
+/*
+====================================================================================================
+  ~*~ RingWalk ~*~
+  Walks rings around a center, from radius first to radius last. Each ring of radius r > 0 starts
+  at center + r * direction(4) and follows the six sides of r steps; radius 0 is the center.
+==================================================================================================*/
+class RingWalk {
+    HexCoords center, current;
+    int radius, side{0}, step{0};
+
+    constexpr HexCoords ring_start(int r) const { return center + hex::direction(4) * r; }
+
+  public:
+    constexpr RingWalk(HexCoords center, int radius)
+        : center(center), current(center + hex::direction(4) * radius), radius(radius) {}
+
+    constexpr HexCoords operator*() const { return current; }
+    constexpr RingWalk& operator++() {
+        if (radius > 0) {
+            current = hex::neighbour(current, side);
+            if (++step < radius) { return *this; }
+            step = 0;
+            if (++side < hex::nb_directions) { return *this; }
+            side = 0;
+        }
+        radius++;
+        current = ring_start(radius);
+        return *this;
+    }
+    // only meaningful between walks around the same center
+    constexpr bool operator==(const RingWalk& other) const {
+        return radius == other.radius and side == other.side and step == other.step;
+    }
+    constexpr bool operator!=(const RingWalk& other) const { return !(*this == other); }
+};
+
+// hexes at exactly radius steps from center (6 * radius of them, or only center if radius is 0)
+class Ring {
+    HexCoords center;
+    int radius;
+
+  public:
+    constexpr Ring(HexCoords center, int radius) : center(center), radius(radius) {}
+    constexpr RingWalk begin() const { return RingWalk(center, radius); }
+    constexpr RingWalk end() const { return RingWalk(center, radius + 1); }
+    constexpr int size() const { return radius == 0 ? 1 : hex::nb_directions * radius; }
+};
+
+// hexes at most radius steps from center, by increasing distance
+class Spiral {
+    HexCoords center;
+    int radius;
+
+  public:
+    constexpr Spiral(HexCoords center, int radius) : center(center), radius(radius) {}
+    constexpr RingWalk begin() const { return RingWalk(center, 0); }
+    constexpr RingWalk end() const { return RingWalk(center, radius + 1); }
+    constexpr int size() const { return 3 * radius * (radius + 1) + 1; }
+};
+
+/*
+====================================================================================================
+  ~*~ Line ~*~
+  Hexes on the segment between two hexes (both included), each one adjacent to the previous one.
+  Endpoints are nudged so that points exactly on an edge always round to the same side.
+==================================================================================================*/
+class Line {
+    HexCoords from, to;
+    int length;
+
+  public:
+    class iterator {
+        const Line* line;
+        int i;
+
+      public:
+        constexpr iterator(const Line* line, int i) : line(line), i(i) {}
+        HexCoords operator*() const { return line->at(i); }
+        constexpr iterator& operator++() {
+            i++;
+            return *this;
+        }
+        constexpr bool operator==(const iterator& other) const { return i == other.i; }
+        constexpr bool operator!=(const iterator& other) const { return i != other.i; }
+    };
+
+    constexpr Line(HexCoords from, HexCoords to) : from(from), to(to), length(from.distance(to)) {}
+
+    // i-th hex of the line, 0 <= i <= length
+    HexCoords at(int i) const {
+        if (i == 0) { return from; }
+        if (i == length) { return to; }
+        ivec a = from.get_axial(), b = to.get_axial();
+        scalar t = scalar(i) / length;
+        return HexCoords::from_fractional(a.x + 1e-4f + (b.x - a.x) * t,
+                                          a.y + 1e-4f + (b.y - a.y) * t);
+    }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, length + 1); }
+    constexpr int size() const { return length + 1; }
+};
@@ -24,7 +24,7 @@
 ==================================================================================================*/
 class Interface : public GameObject, public Component {
     sf::Text text;
-    sf::Font font;
+    FontHandle font;
     int toolbar_size = 4;
     scalar button_size = 100;
     scalar space_between_buttons = 10;
@@ -51,8 +51,8 @@ class Interface : public GameObject, public Component {
     int select{1};
 
     Interface() : selector(vec(button_size, button_size)) {
-        font.loadFromFile("DejaVuSans.ttf");
-        text.setFont(font);
+        port("resources", &Interface::load_resources);
+
         text.setCharacterSize(24);
         text.setFillColor(sf::Color(255, 255, 255, 100));
         text.setStyle(sf::Text::Bold);
@@ -62,19 +62,24 @@ class Interface : public GameObject, public Component {
             buttons.back().setFillColor(sf::Color(255, 255, 255, 50));
         }
 
-        icons.push_back(make_unique<SimpleObject>(144, "png/menhir.png"));
-        icons.back()->get_sprite().setScale(0.45, 0.45);
-        icons.push_back(make_unique<SimpleObject>(144, "png/faith.png"));
-        icons.push_back(make_unique<SimpleObject>(144, "png/altar.png"));
-        icons.back()->get_sprite().setScale(0.9, 0.9);
-        icons.push_back(make_unique<SimpleObject>(144, "png/tree1.png"));
-        icons.back()->get_sprite().setScale(0.45, 0.45);
-
         selector.setFillColor(sf::Color(255, 255, 255, 0));
         selector.setOutlineColor(sf::Color::Red);
         selector.setOutlineThickness(2);
     }
 
+    void load_resources(ResourceManager* resources) {
+        font = resources->get_font("DejaVuSans.ttf");
+        text.setFont(*font);
+
+        icons.push_back(make_unique<SimpleObject>(144, resources->get_sprite("png/menhir.png")));
+        icons.back()->get_sprite().setScale(0.45, 0.45);
+        icons.push_back(make_unique<SimpleObject>(144, resources->get_sprite("png/faith.png")));
+        icons.push_back(make_unique<SimpleObject>(144, resources->get_sprite("png/altar.png")));
+        icons.back()->get_sprite().setScale(0.9, 0.9);
+        icons.push_back(make_unique<SimpleObject>(144, resources->get_sprite("png/tree1.png")));
+        icons.back()->get_sprite().setScale(0.45, 0.45);
+    }
+
     void before_draw(vec wdim, scalar fps) {
         text.setString(std::to_string((int)floor(fps + 0.5f)));
         // vec wdim = view->get_size();
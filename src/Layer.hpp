@@ -15,36 +15,171 @@
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include "OffsetRect.hpp"
+#include "SpriteBatch.hpp"
 #include "ViewController.hpp"
 #include "globals.hpp"
 
 /*
 ====================================================================================================
   ~*~ Layer ~*~
+  Objects drawn in the same view, by increasing y, through a sprite batch so that consecutive
+  objects sharing a texture are drawn together. Sprite streams (already sorted) are merged in.
+  Order is maintained incrementally: from one frame to the next, objects move little, so an
+  insertion sort runs in about linear time.
+  A culling layer only draws objects near its view. Objects are assumed not to move and are
+  indexed by the square of hexes they stand on, in buckets kept sorted by y, except those added
+  with add_mobile_object which are tested one by one. The visible buckets and mobile objects are
+  then merged.
 ==================================================================================================*/
 class Layer : public sf::Drawable, public Component {
-    vector<GameObject*> objects;
+    vector<GameObject*> objects;  // all of them without culling, only mobile ones with culling
     View* view;
 
+    bool cull;
+    scalar w;                              // of hexes, for culling
+    static constexpr int bucket_size = 8;  // in hexes
+    static constexpr scalar margin = 300;  // sprites can extend that far from their position
+    std::map<ivec, vector<GameObject*>, ivec_compare_y> buckets;
+    vector<GameObject*> visible, visible_static, visible_mobile;
+    mutable SpriteBatch sprite_batch;  // reused to avoid allocations
+    vector<SpriteStream*> streams;
+    mutable vector<size_t> stream_cursors;
+
+    static bool above(GameObject* ptr1, GameObject* ptr2) {
+        return ptr1->getPosition().y < ptr2->getPosition().y;
+    }
+
+    static void insertion_sort(vector<GameObject*>& v) {
+        for (size_t i = 1; i < v.size(); i++) {
+            auto o = v[i];
+            size_t j = i;
+            for (; j > 0 and above(o, v[j - 1]); j--) {
+                v[j] = v[j - 1];
+            }
+            v[j] = o;
+        }
+    }
+
+    ivec bucket_of(vec position) const {
+        ivec offset = HexCoords::from_pixel(w, position).get_offset();
+        auto floor = [](int i) { return i < 0 ? (i + 1) / bucket_size - 1 : i / bucket_size; };
+        return ivec(floor(offset.x), floor(offset.y));
+    }
+
+    void cull_objects() {
+        vec center = view->get().getCenter(), size = view->get().getSize();
+        vec tl = center - size / 2 - vec(margin, margin);
+        vec br = center + size / 2 + vec(margin, margin);
+
+        // buckets of the same row cover the same y range and are merged, successive rows
+        // are (almost) already in order
+        visible_static.clear();
+        OffsetRect rect(bucket_of(tl), bucket_of(br));
+        for (int y = rect.tl.y; y <= rect.br.y; y++) {
+            auto row_begin = visible_static.size();
+            for (int x = rect.tl.x; x <= rect.br.x; x++) {
+                auto it = buckets.find(ivec(x, y));
+                if (it != buckets.end()) {
+                    auto middle = visible_static.size();
+                    visible_static.insert(visible_static.end(), it->second.begin(),
+                                          it->second.end());
+                    std::inplace_merge(visible_static.begin() + row_begin,
+                                       visible_static.begin() + middle, visible_static.end(),
+                                       above);
+                }
+            }
+        }
+        insertion_sort(visible_static);  // objects between two rows of hexes
+
+        insertion_sort(objects);
+        visible_mobile.clear();
+        for (auto o : objects) {
+            vec position = o->getPosition();
+            if (position.x >= tl.x and position.x <= br.x and position.y >= tl.y and
+                position.y <= br.y) {
+                visible_mobile.push_back(o);
+            }
+        }
+
+        visible.resize(visible_static.size() + visible_mobile.size());
+        std::merge(visible_static.begin(), visible_static.end(), visible_mobile.begin(),
+                   visible_mobile.end(), visible.begin(), above);
+    }
+
   public:
-    Layer() {
+    Layer() : cull(false), w(0) {
         port("view", &Layer::view);
         port("objects", &Layer::add_object);
+        port("streams", &Layer::add_stream);
+    }
+
+    // culling layer, for hexes of width w
+    explicit Layer(scalar w) : Layer() {
+        cull = true;
+        this->w = w;
     }
 
     void before_draw() {
-        sort(objects.begin(), objects.end(), [](GameObject* ptr1, GameObject* ptr2) {
-            return ptr1->getPosition().y < ptr2->getPosition().y;
-        });
+        if (cull) {
+            cull_objects();
+        } else {
+            insertion_sort(objects);
+        }
     }
 
     void set_view() { view->use(); }
 
-    void add_object(GameObject* ptr) { objects.push_back(ptr); }
+    // the object must not move afterwards if the layer culls
+    void add_object(GameObject* ptr) {
+        if (cull) {
+            auto& bucket = buckets[bucket_of(ptr->getPosition())];
+            bucket.insert(std::upper_bound(bucket.begin(), bucket.end(), ptr, above), ptr);
+        } else {
+            objects.push_back(ptr);
+        }
+    }
+
+    void add_mobile_object(GameObject* ptr) { objects.push_back(ptr); }
+
+    void add_stream(SpriteStream* ptr) { streams.push_back(ptr); }
 
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
-        for (auto& o : objects) {
-            target.draw(*o, states);
+        auto& to_draw = cull ? visible : objects;
+        sprite_batch.begin(target, states);
+        stream_cursors.assign(streams.size(), 0);
+        size_t next_object = 0;
+        while (true) {
+            // next sprite of the streams, if it comes before the next object
+            scalar depth = next_object < to_draw.size() ? to_draw[next_object]->getPosition().y
+                                                        : std::numeric_limits<scalar>::infinity();
+            int stream = -1;
+            for (size_t s = 0; s < streams.size(); s++) {
+                size_t cursor = stream_cursors[s];
+                if (cursor < streams[s]->nb_quads() and streams[s]->get_depth(cursor) < depth) {
+                    depth = streams[s]->get_depth(cursor);
+                    stream = s;
+                }
+            }
+
+            if (stream >= 0) {
+                auto s = streams[stream];
+                sprite_batch.add(s->get_quad(stream_cursors[stream]++), s->get_texture());
+            } else if (next_object < to_draw.size()) {
+                auto o = to_draw[next_object++];
+                if (!o->batch(sprite_batch)) {
+                    sprite_batch.flush();
+                    target.draw(*o, states);
+                }
+            } else {
+                break;
+            }
         }
+        sprite_batch.flush();
     }
+
+    unsigned get_draw_calls() const { return sprite_batch.get_draw_calls(); }
 };
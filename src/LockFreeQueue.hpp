@@ -0,0 +1,67 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/*
+====================================================================================================
+  ~*~ LockFreeQueue ~*~
+  Unbounded multiple-producer single-consumer queue (intrusive linked list with a stub node, as
+  described by D. Vyukov). push never blocks and can be called from any thread; pop must always
+  be called from the same consumer thread.
+==================================================================================================*/
+template <class T>
+class LockFreeQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    std::atomic<Node*> head;  // last pushed node, shared by producers
+    Node* tail;               // stub node owned by the consumer
+
+  public:
+    LockFreeQueue() : head(new Node), tail(head.load()) {}
+    LockFreeQueue(const LockFreeQueue&) = delete;
+
+    ~LockFreeQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete tail;
+    }
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value = std::move(value);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // returns false if the queue is empty (or if a push is not fully published yet)
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
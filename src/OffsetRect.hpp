@@ -0,0 +1,136 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <algorithm>
+#include "HexCoords.hpp"
+
+// row-major order, the order in which rectangles are iterated
+struct ivec_compare_y {
+    bool operator()(const ivec& v1, const ivec& v2) const {
+        return v1.y == v2.y ? v1.x < v2.x : v1.y < v2.y;
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ OffsetRect ~*~
+  Rectangle of hexes in offset coordinates (bounds included), iterable row by row without
+  allocation.
+==================================================================================================*/
+struct OffsetRect {
+    ivec tl{0, 0}, br{-1, -1};  // empty by default
+
+    class iterator {
+        int x, y, x_begin, x_end;
+
+      public:
+        iterator(int x, int y, int x_begin, int x_end)
+            : x(x), y(y), x_begin(x_begin), x_end(x_end) {}
+
+        HexCoords operator*() const { return HexCoords::from_offset(x, y); }
+
+        iterator& operator++() {
+            if (++x > x_end) {
+                x = x_begin;
+                y++;
+            }
+            return *this;
+        }
+
+        bool operator!=(const iterator& other) const { return x != other.x or y != other.y; }
+    };
+
+    OffsetRect() = default;
+    OffsetRect(ivec tl, ivec br) : tl(tl), br(br) {}
+
+    bool empty() const { return br.x < tl.x or br.y < tl.y; }
+    int width() const { return empty() ? 0 : br.x - tl.x + 1; }
+    int height() const { return empty() ? 0 : br.y - tl.y + 1; }
+    int size() const { return width() * height(); }
+
+    bool contains(ivec o) const {
+        return o.x >= tl.x and o.x <= br.x and o.y >= tl.y and o.y <= br.y;
+    }
+    bool contains(const HexCoords& coords) const { return contains(coords.get_offset()); }
+
+    // row-major position of a contained offset, and back
+    int index(ivec o) const { return (o.y - tl.y) * width() + (o.x - tl.x); }
+    ivec offset(int index) const { return ivec(tl.x + index % width(), tl.y + index / width()); }
+
+    OffsetRect intersection(const OffsetRect& other) const {
+        return OffsetRect(ivec(std::max(tl.x, other.tl.x), std::max(tl.y, other.tl.y)),
+                          ivec(std::min(br.x, other.br.x), std::min(br.y, other.br.y)));
+    }
+
+    iterator begin() const { return empty() ? end() : iterator(tl.x, tl.y, tl.x, br.x); }
+    iterator end() const { return iterator(tl.x, empty() ? tl.y : br.y + 1, tl.x, br.x); }
+
+    bool operator==(const OffsetRect& other) const {
+        return (empty() and other.empty()) or (tl == other.tl and br == other.br);
+    }
+    bool operator!=(const OffsetRect& other) const { return !(*this == other); }
+};
+
+/*
+====================================================================================================
+  ~*~ RectDifference ~*~
+  The hexes of a that are not in b, as up to 4 disjoint rectangles (bands above and below b, then
+  strips left and right of it).
+==================================================================================================*/
+class RectDifference {
+    OffsetRect rects[4];
+    int count{0};
+
+    void add(OffsetRect rect) {
+        if (!rect.empty()) rects[count++] = rect;
+    }
+
+  public:
+    RectDifference(const OffsetRect& a, const OffsetRect& b) {
+        OffsetRect common = a.intersection(b);
+        if (common.empty()) {
+            add(a);
+            return;
+        }
+        add(OffsetRect(a.tl, ivec(a.br.x, common.tl.y - 1)));
+        add(OffsetRect(ivec(a.tl.x, common.br.y + 1), a.br));
+        add(OffsetRect(ivec(a.tl.x, common.tl.y), ivec(common.tl.x - 1, common.br.y)));
+        add(OffsetRect(ivec(common.br.x + 1, common.tl.y), ivec(a.br.x, common.br.y)));
+    }
+
+    const OffsetRect* begin() const { return rects; }
+    const OffsetRect* end() const { return rects + count; }
+
+    int size() const {
+        int result = 0;
+        for (auto& r : *this) result += r.size();
+        return result;
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ ViewDiff ~*~
+  Visible rectangle and what changed since the previous frame.
+==================================================================================================*/
+struct ViewDiff {
+    OffsetRect current, previous;
+
+    bool changed() const { return current != previous; }
+    RectDifference entered() const { return RectDifference(current, previous); }
+    RectDifference exited() const { return RectDifference(previous, current); }
+};
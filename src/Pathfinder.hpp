@@ -0,0 +1,320 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include "FlowField.hpp"
+#include "HexTopology.hpp"
+#include "OffsetRect.hpp"
+#include "TerrainGenerator.hpp"
+#include "TileData.hpp"
+
+struct PathStats {
+    unsigned queries{0};      // paths
+    unsigned flow_fields{0};  // built
+    unsigned failures{0};     // no path or no field, or search abandoned
+    size_t expanded{0};       // nodes, over all searches
+    double total_ms{0}, last_ms{0}, max_ms{0};
+};
+
+enum class PathStatus { searching, found, failed };
+
+/*
+====================================================================================================
+  ~*~ Pathfinder ~*~
+  A* over hexes, the cost of entering a tile depending on its soil type and on whether it is a
+  forest (an infinite cost makes a tile impassable). The search is restricted to a rectangle
+  around both ends, with a margin so that paths can go around obstacles.
+  Node arrays cover that rectangle and are kept from one query to the next: instead of being
+  cleared, their entries are stamped with the query they belong to. The open list is a binary heap
+  in a vector that is also kept, so that queries do not allocate once the largest rectangle has
+  been seen. As long as no other query is started, a search can be resumed where it stopped, so
+  that a long one can be spread over several frames (see start_path and extend_path).
+  Flow fields are built by the same kind of search, run backwards from the target (Dijkstra) over
+  a whole rectangle, with the same costs. The sweep can be spread over several frames, its open
+  list being kept in the field.
+==================================================================================================*/
+class Pathfinder : public Component {
+    static constexpr scalar infinity = std::numeric_limits<scalar>::infinity();
+    static constexpr uint32_t no_parent = std::numeric_limits<uint32_t>::max();
+
+    TerrainSource* terrain{nullptr};
+    std::array<scalar, TerrainGenerator::nb_soil_types> soil_costs;
+    scalar forest_cost{2};  // added to the soil cost
+    int margin{8};          // around the rectangle spanned by both ends, in tiles
+    size_t max_nodes{1 << 18};
+
+    // one entry per tile of the search rectangle
+    OffsetRect window;
+    vector<uint32_t> stamp;   // query that last reached the tile
+    vector<uint8_t> closed;   // only meaningful if stamped
+    vector<scalar> cost;      // from the start, only meaningful if stamped
+    vector<uint32_t> parent;  // only meaningful if stamped
+    uint32_t query{0};
+
+    // the query in progress, if searching
+    bool searching{false};
+    HexCoords from, to;
+    uint32_t goal;
+    scalar heuristic_factor;
+    size_t query_expanded;
+    double query_ms;
+
+    struct OpenNode {
+        scalar estimate;  // cost + heuristic
+        uint32_t index;
+        bool operator<(const OpenNode& other) const { return estimate > other.estimate; }
+    };
+    vector<OpenNode> open;  // min-heap, with duplicates skipped when popped
+
+    PathStats stats;
+
+    uint32_t index_of(ivec offset) const { return window.index(offset); }
+    HexCoords coords_of(uint32_t index) const {
+        return HexCoords::from_offset(window.offset(index));
+    }
+
+    scalar min_step_cost() const { return *std::min_element(soil_costs.begin(), soil_costs.end()); }
+
+    void reset_nodes() {
+        size_t size = window.size();
+        if (stamp.size() < size) {
+            stamp.resize(size, 0);
+            closed.resize(size);
+            cost.resize(size);
+            parent.resize(size);
+        }
+        if (++query == 0) {  // stamps wrapped around
+            std::fill(stamp.begin(), stamp.end(), 0);
+            query = 1;
+        }
+        open.clear();
+    }
+
+    static double ms_since(std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+            .count();
+    }
+
+    void record(double ms, bool succeeded, size_t expanded) {
+        stats.failures += !succeeded;
+        stats.expanded += expanded;
+        stats.total_ms += ms;
+        stats.last_ms = ms;
+        stats.max_ms = std::max(stats.max_ms, ms);
+    }
+
+    // expands nodes for about budget ms at most
+    PathStatus search(double budget_ms) {
+        auto begin = std::chrono::steady_clock::now();
+        size_t expanded = 0;
+        while (!open.empty()) {
+            if (expanded % 64 == 0 and ms_since(begin) >= budget_ms) {
+                query_expanded += expanded;
+                return PathStatus::searching;
+            }
+            std::pop_heap(open.begin(), open.end());
+            uint32_t current = open.back().index;
+            open.pop_back();
+            if (closed[current]) {
+                continue;
+            }
+            if (current == goal) {
+                query_expanded += expanded;
+                return PathStatus::found;
+            }
+            closed[current] = true;
+            expanded++;
+
+            HexCoords coords = coords_of(current);
+            for (auto next : Neighbours(coords)) {
+                ivec offset = next.get_offset();
+                if (!window.contains(offset)) {
+                    continue;
+                }
+                uint32_t i = index_of(offset);
+                if (stamp[i] == query and closed[i]) {
+                    continue;
+                }
+                scalar next_cost = cost[current] + step_cost(terrain->terrain_at(next));
+                if (next_cost == infinity or (stamp[i] == query and next_cost >= cost[i])) {
+                    continue;
+                }
+                stamp[i] = query;
+                closed[i] = false;
+                cost[i] = next_cost;
+                parent[i] = current;
+                open.push_back(OpenNode{next_cost + next.distance(to) * heuristic_factor, i});
+                std::push_heap(open.begin(), open.end());
+            }
+        }
+        query_expanded += expanded;
+        return PathStatus::failed;
+    }
+
+    void finish_query(bool found) {
+        searching = false;
+        record(query_ms, found, query_expanded);
+    }
+
+  public:
+    Pathfinder() {
+        soil_costs.fill(1);
+        port("terrain", &Pathfinder::terrain);
+    }
+
+    // cost of entering a tile
+    scalar step_cost(TileData tile) const {
+        return soil_costs[tile.first] + (tile.second == 0 ? forest_cost : 0);
+    }
+
+    // starts a search from one hex to another, abandoning the one in progress if any; the search
+    // itself is done by extend_path, possibly over several frames
+    bool start_path(HexCoords start, HexCoords end) {
+        auto begin = std::chrono::steady_clock::now();
+        if (searching) {
+            finish_query(false);
+        }
+        stats.queries++;
+        from = start;
+        to = end;
+        query_expanded = 0;
+        query_ms = 0;
+
+        ivec a = from.get_offset(), b = to.get_offset();
+        window = OffsetRect(ivec(std::min(a.x, b.x) - margin, std::min(a.y, b.y) - margin),
+                            ivec(std::max(a.x, b.x) + margin, std::max(a.y, b.y) + margin));
+        searching = size_t(window.size()) <= max_nodes;
+        if (searching) {
+            reset_nodes();
+            heuristic_factor = min_step_cost();
+            uint32_t first = index_of(a);
+            goal = index_of(b);
+            stamp[first] = query;
+            closed[first] = false;
+            cost[first] = 0;
+            parent[first] = no_parent;
+            open.push_back(OpenNode{from.distance(to) * heuristic_factor, first});
+        }
+        query_ms = ms_since(begin);
+        if (!searching) {
+            finish_query(false);
+        }
+        return searching;
+    }
+
+    // searches for about budget ms at most; once found, the path (both ends included) is in path
+    PathStatus extend_path(vector<HexCoords>& path, double budget_ms) {
+        if (!searching) {
+            return PathStatus::failed;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        PathStatus status = search(budget_ms);
+        if (status == PathStatus::found) {
+            path.clear();
+            for (uint32_t i = goal; i != no_parent; i = parent[i]) {
+                path.push_back(coords_of(i));
+            }
+            std::reverse(path.begin(), path.end());
+        }
+        query_ms += ms_since(begin);
+        if (status != PathStatus::searching) {
+            finish_query(status == PathStatus::found);
+        }
+        return status;
+    }
+
+    bool is_searching() const { return searching; }
+
+    // the whole search at once, path is cleared first
+    bool find_path(HexCoords start, HexCoords end, vector<HexCoords>& path) {
+        path.clear();
+        return start_path(start, end) and extend_path(path, infinity) == PathStatus::found;
+    }
+
+    // starts a flow field towards target over area (which should contain it); the sweep itself
+    // is done by extend_flow_field, possibly over several frames
+    bool start_flow_field(HexCoords target, const OffsetRect& area, FlowField& field) {
+        bool started = area.contains(target) and size_t(area.size()) <= max_nodes;
+        if (started) {
+            field.reset(area, target);
+            uint32_t goal = area.index(target.get_offset());
+            field.cost[goal] = 0;
+            field.frontier.push_back(FlowField::Node{0, goal});
+        }
+        stats.flow_fields++;
+        stats.failures += !started;
+        return started;
+    }
+
+    // sweeps for about budget ms at most; returns whether the field is complete
+    bool extend_flow_field(FlowField& field, double budget_ms) {
+        auto begin = std::chrono::steady_clock::now();
+        auto& frontier = field.frontier;
+        size_t expanded = 0;
+        while (!frontier.empty() and (expanded % 64 != 0 or ms_since(begin) < budget_ms)) {
+            std::pop_heap(frontier.begin(), frontier.end());
+            FlowField::Node current = frontier.back();
+            frontier.pop_back();
+            if (current.cost > field.cost[current.index]) {
+                continue;  // reached again at a lower cost since pushed
+            }
+            expanded++;
+
+            // walking from a neighbour to the current tile costs entering the current tile
+            HexCoords coords = HexCoords::from_offset(field.area.offset(current.index));
+            scalar next_cost = current.cost + step_cost(terrain->terrain_at(coords));
+            if (next_cost == infinity) {
+                continue;
+            }
+            for (int d = 0; d < hex::nb_directions; d++) {
+                ivec offset = hex::neighbour(coords, d).get_offset();
+                if (!field.area.contains(offset)) {
+                    continue;
+                }
+                uint32_t i = field.area.index(offset);
+                if (next_cost < field.cost[i]) {
+                    field.cost[i] = next_cost;
+                    field.direction[i] = (d + hex::nb_directions / 2) % hex::nb_directions;
+                    frontier.push_back(FlowField::Node{next_cost, i});
+                    std::push_heap(frontier.begin(), frontier.end());
+                }
+            }
+        }
+        record(ms_since(begin), true, expanded);
+        return frontier.empty();
+    }
+
+    // the whole sweep at once
+    bool build_flow_field(HexCoords target, const OffsetRect& area, FlowField& field) {
+        return start_flow_field(target, area, field) and extend_flow_field(field, infinity);
+    }
+
+    void set_terrain(TerrainSource* source) { terrain = source; }
+    void set_soil_cost(int soil_type, scalar cost) { soil_costs[soil_type] = cost; }
+    void set_forest_cost(scalar cost) { forest_cost = cost; }
+    void set_margin(int tiles) { margin = tiles; }
+    void set_max_nodes(size_t nodes) { max_nodes = nodes; }
+
+    const PathStats& get_stats() const { return stats; }
+    void reset_stats() { stats = PathStats(); }
+};
+
+constexpr scalar Pathfinder::infinity;
+constexpr uint32_t Pathfinder::no_parent;
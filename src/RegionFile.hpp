@@ -0,0 +1,155 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include "binary.hpp"
+#include "globals.hpp"
+
+/*
+====================================================================================================
+  ~*~ RegionFile ~*~
+  Groups the encoded data of region_size x region_size cells in one file, mapped in memory so that
+  cells can be decoded straight from the mapped pages.
+  Layout: "MHRG" | u16 version | u16 region size | one (u32 offset, u32 size) entry per cell, row
+  by row | cell data. A size of 0 means the cell is absent. Cell data is never overwritten: new
+  data is appended and only then is the entry switched to it, so that an interrupted write leaves
+  the previous version readable (the pack tool reclaims the dead space).
+==================================================================================================*/
+class RegionFile {
+  public:
+    static const int region_size = 32;  // in cells
+    static const uint16_t format_version = 1;
+    static const size_t header_size = 8 + 8 * region_size * region_size;
+
+  private:
+    int fd{-1};
+    char* map{nullptr};
+    size_t map_capacity{0};  // mapped length, may go past the end of the file
+    size_t file_size{0};
+    std::shared_timed_mutex mutex;  // shared for reads, exclusive for writes and remaps
+
+    static size_t entry(ivec local) { return 8 + 8 * (local.y * region_size + local.x); }
+
+    // maps more than the file so that appending cells rarely needs a remap
+    void remap(size_t capacity) {
+        if (map != nullptr) {
+            munmap(map, map_capacity);
+        }
+        void* ptr = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+        map = ptr == MAP_FAILED ? nullptr : static_cast<char*>(ptr);
+        map_capacity = map == nullptr ? 0 : capacity;
+    }
+
+    bool write_at(const char* data, size_t size, size_t offset) {
+        return pwrite(fd, data, size, offset) == static_cast<ssize_t>(size);
+    }
+
+  public:
+    // opens the region file, creating it only if asked to (otherwise a missing file is invalid)
+    RegionFile(const string& path, bool create = false) {
+        fd = open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        file_size = st.st_size;
+        if (file_size == 0 and create) {
+            string header(header_size, '\0');
+            std::copy_n("MHRG", 4, &header[0]);
+            binary::write_u16(&header[4], format_version);
+            binary::write_u16(&header[6], region_size);
+            file_size = write_at(header.data(), header_size, 0) ? header_size : 0;
+        }
+        remap(std::max(file_size, header_size + 1024 * region_size * region_size));
+    }
+
+    RegionFile(const RegionFile&) = delete;
+
+    ~RegionFile() {
+        if (map != nullptr) munmap(map, map_capacity);
+        if (fd >= 0) close(fd);
+    }
+
+    bool is_valid() const {
+        return map != nullptr and file_size >= header_size and std::equal(map, map + 4, "MHRG") and
+               binary::read_u16(map + 4) == format_version and
+               binary::read_u16(map + 6) == region_size;
+    }
+
+    static ivec region_of(ivec cell) {
+        auto floor_div = [](int i) { return i < 0 ? (i + 1) / region_size - 1 : i / region_size; };
+        return ivec(floor_div(cell.x), floor_div(cell.y));
+    }
+
+    static ivec local_coords(ivec cell) { return cell - region_of(cell) * region_size; }
+
+    // calls f(const char* data, size_t size) on the mapped data of the cell, if present
+    template <class F>
+    bool read(ivec cell, F&& f) {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        if (!is_valid()) {
+            return false;
+        }
+        const char* e = map + entry(local_coords(cell));
+        size_t offset = binary::read_u32(e), size = binary::read_u32(e + 4);
+        if (size == 0 or offset + size > file_size) {
+            return false;
+        }
+        f(static_cast<const char*>(map + offset), size);
+        return true;
+    }
+
+    bool write(ivec cell, const string& data) {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex);
+        if (!is_valid()) {
+            return false;
+        }
+        size_t e = entry(local_coords(cell)), offset = file_size;
+        if (!write_at(data.data(), data.size(), offset)) {
+            return false;
+        }
+        file_size = offset + data.size();
+
+        char new_entry[8];
+        binary::write_u32(new_entry, uint32_t(offset));
+        binary::write_u32(new_entry + 4, uint32_t(data.size()));
+        bool ok = write_at(new_entry, 8, e);
+        if (file_size > map_capacity) {
+            remap(2 * file_size);
+        }
+        return ok;
+    }
+
+    // calls f(ivec local_coords, const char* data, size_t size) for every present cell
+    template <class F>
+    void for_each(F&& f) {
+        for (int y = 0; y < region_size; y++) {
+            for (int x = 0; x < region_size; x++) {
+                read(ivec(x, y), [&](const char* data, size_t size) { f(ivec(x, y), data, size); });
+            }
+        }
+    }
+
+    size_t get_file_size() const { return file_size; }
+};
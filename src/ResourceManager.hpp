@@ -0,0 +1,114 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include "TextureAtlas.hpp"
+#include "TextureRegion.hpp"
+#include "globals.hpp"
+
+using FontHandle = std::shared_ptr<const sf::Font>;
+
+/*
+====================================================================================================
+  ~*~ ResourceManager ~*~
+  Loads each texture/font file once and hands out shared handles to it. The manager keeps a
+  reference of its own so that assets stay cached even when no object uses them at the moment.
+  Object sprites are packed into an atlas, built on first use, and handed out as regions of it.
+==================================================================================================*/
+class ResourceManager : public Component {
+    template <class Resource>
+    struct Entry {
+        std::shared_ptr<Resource> resource;
+        size_t bytes;
+    };
+
+    std::map<string, Entry<sf::Texture>> textures;  // std::map so that reports are sorted by path
+    std::map<string, Entry<sf::Font>> fonts;
+
+    vector<string> atlas_paths;
+    unique_ptr<TextureAtlas> atlas;
+
+    static size_t file_size(const string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        return file ? static_cast<size_t>(file.tellg()) : 0;
+    }
+
+    template <class Resource>
+    static void report_entries(std::ostream& os, const std::map<string, Entry<Resource>>& entries) {
+        for (auto& e : entries) {
+            // the manager itself holds one reference
+            os << "  " << e.first << ": " << e.second.bytes / 1024 << " KiB, "
+               << e.second.resource.use_count() - 1 << " user(s)\n";
+        }
+    }
+
+  public:
+    ResourceManager(vector<string> atlas_paths = {}) : atlas_paths(atlas_paths) {}
+
+    TextureHandle get_texture(const string& path) {
+        auto it = textures.find(path);
+        if (it == textures.end()) {
+            auto texture = std::make_shared<sf::Texture>();
+            texture->loadFromFile(path);
+            auto size = texture->getSize();
+            size_t bytes = size_t(size.x) * size.y * 4;  // RGBA8 on the GPU
+            it = textures.emplace(path, Entry<sf::Texture>{texture, bytes}).first;
+        }
+        return it->second.resource;
+    }
+
+    // the region of the atlas if the file is part of it, else the whole texture
+    TextureRegion get_sprite(const string& path) {
+        if (!atlas and !atlas_paths.empty()) {
+            atlas = make_unique<TextureAtlas>(atlas_paths);
+        }
+        if (atlas and atlas->contains(path)) {
+            return atlas->get(path);
+        }
+        return TextureRegion(get_texture(path));
+    }
+
+    FontHandle get_font(const string& path) {
+        auto it = fonts.find(path);
+        if (it == fonts.end()) {
+            auto font = std::make_shared<sf::Font>();
+            font->loadFromFile(path);
+            it = fonts.emplace(path, Entry<sf::Font>{font, file_size(path)}).first;
+        }
+        return it->second.resource;
+    }
+
+    size_t memory_usage() const {
+        size_t result = 0;
+        for (auto& t : textures) result += t.second.bytes;
+        for (auto& f : fonts) result += f.second.bytes;
+        if (atlas) result += atlas->memory_usage();
+        return result;
+    }
+
+    void report(std::ostream& os) const {
+        os << "Resources: " << memory_usage() / 1024 << " KiB\n";
+        if (atlas) {
+            os << "  atlas: " << atlas->size() << " images in " << atlas->get_pages().size()
+               << " page(s), " << atlas->memory_usage() / 1024 << " KiB\n";
+        }
+        report_entries(os, textures);
+        report_entries(os, fonts);
+    }
+};
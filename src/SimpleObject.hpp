@@ -1,10 +1,12 @@
 #pragma once
 
 #include "HexCoords.hpp"
+#include "ResourceManager.hpp"
+#include "SpriteBatch.hpp"
 #include "globals.hpp"
 
 class SimpleObject : public GameObject {
-    sf::Texture texture;
+    TextureHandle texture;  // keeps the shared texture alive, if any
     sf::Sprite sprite;
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
@@ -22,15 +24,20 @@ class SimpleObject : public GameObject {
         setPosition(hex.get_pixel(w));
     }
 
-    SimpleObject(scalar w, std::string texture_path, HexCoords hex = HexCoords(),
-                 scalar shift = 0) {
-        texture.loadFromFile(texture_path);
-        sprite.setTexture(texture);
+    SimpleObject(scalar w, TextureRegion region, HexCoords hex = HexCoords(), scalar shift = 0)
+        : texture(region.texture) {
+        sprite.setTexture(*texture);
+        sprite.setTextureRect(region.rect);
         vec origin(sprite.getLocalBounds().width / 2,
                    (sprite.getLocalBounds().height / 2) * (1 + shift));
         sprite.setOrigin(origin);
         setPosition(hex.get_pixel(w));
     }
 
+    bool batch(SpriteBatch& batch) const override {
+        batch.add(sprite, getTransform());
+        return true;
+    }
+
     sf::Sprite& get_sprite() { return sprite; }
 };
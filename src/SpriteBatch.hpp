@@ -0,0 +1,95 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <cstdlib>
+#include "globals.hpp"
+
+/*
+====================================================================================================
+  ~*~ SpriteBatch ~*~
+  Accumulates consecutive sprites that share a texture into a single array of quads, which is
+  drawn (in one draw call) when a sprite with another texture comes or on flush. Draw order is
+  preserved.
+==================================================================================================*/
+class SpriteBatch {
+    sf::RenderTarget* target{nullptr};
+    sf::RenderStates states;
+    vector<sf::Vertex> vertices;
+    unsigned draw_calls{0};
+
+  public:
+    void begin(sf::RenderTarget& new_target, sf::RenderStates new_states) {
+        target = &new_target;
+        states = new_states;
+        states.texture = nullptr;
+        vertices.clear();
+        draw_calls = 0;
+    }
+
+    // transform is that of the object owning the sprite
+    void add(const sf::Sprite& sprite, const sf::Transform& transform) {
+        if (sprite.getTexture() != states.texture) {
+            flush();
+            states.texture = sprite.getTexture();
+        }
+
+        sf::Transform t = transform * sprite.getTransform();
+        sf::IntRect rect = sprite.getTextureRect();
+        vec size(std::abs(rect.width), std::abs(rect.height));
+        vec tex_tl(rect.left, rect.top), tex_size(rect.width, rect.height);
+        sf::Color color = sprite.getColor();
+        vertices.emplace_back(t.transformPoint(0, 0), color, tex_tl);
+        vertices.emplace_back(t.transformPoint(size.x, 0), color, tex_tl + vec(tex_size.x, 0));
+        vertices.emplace_back(t.transformPoint(size.x, size.y), color, tex_tl + tex_size);
+        vertices.emplace_back(t.transformPoint(0, size.y), color, tex_tl + vec(0, tex_size.y));
+    }
+
+    // four vertices, already transformed
+    void add(const sf::Vertex* quad, const sf::Texture* texture) {
+        if (texture != states.texture) {
+            flush();
+            states.texture = texture;
+        }
+        vertices.insert(vertices.end(), quad, quad + 4);
+    }
+
+    void flush() {
+        if (!vertices.empty()) {
+            target->draw(vertices.data(), vertices.size(), sf::Quads, states);
+            vertices.clear();
+            draw_calls++;
+        }
+    }
+
+    // since the last begin
+    unsigned get_draw_calls() const { return draw_calls; }
+};
+
+/*
+====================================================================================================
+  ~*~ SpriteStream ~*~
+  Many sprites that are not objects of their own (e.g. a crowd), given as ready-made quads sorted by
+  increasing depth, so that a layer can interleave them with its objects.
+==================================================================================================*/
+struct SpriteStream {
+    virtual ~SpriteStream() {}
+
+    virtual size_t nb_quads() const = 0;
+    virtual scalar get_depth(size_t quad) const = 0;  // y of the sprite's position
+    virtual const sf::Vertex* get_quad(size_t quad) const = 0;
+    virtual const sf::Texture* get_texture() const = 0;
+};
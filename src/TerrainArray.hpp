@@ -0,0 +1,93 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include "HexCoords.hpp"
+#include "TileData.hpp"
+
+/*
+====================================================================================================
+  ~*~ TerrainArray ~*~
+  Flat array of TileData covering a rectangle in offset coordinates. Tiles are stored row by row
+  so that coordinates <-> index conversions are O(1) and iterating over tiles is a linear scan.
+==================================================================================================*/
+class TerrainArray {
+    ivec tl;  // offset coordinates of the top-left tile
+    int width{0}, height{0};
+    vector<TileData> tiles;
+
+  public:
+    // iterates over (HexCoords, TileData&) pairs in storage order
+    template <class Data>
+    class Iterator {
+        Data* ptr;
+        ivec tl;
+        int width, x, y;
+
+      public:
+        Iterator(Data* ptr, ivec tl, int width, int x = 0, int y = 0)
+            : ptr(ptr), tl(tl), width(width), x(x), y(y) {}
+
+        pair<HexCoords, Data&> operator*() const {
+            return pair<HexCoords, Data&>(HexCoords::from_offset(tl.x + x, tl.y + y), *ptr);
+        }
+
+        Iterator& operator++() {
+            ptr++;
+            if (++x == width) {
+                x = 0;
+                y++;
+            }
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const { return ptr != other.ptr; }
+    };
+
+    // br is excluded
+    TerrainArray(ivec tl, ivec br)
+        : tl(tl), width(br.x - tl.x), height(br.y - tl.y), tiles(width * height) {}
+
+    size_t size() const { return tiles.size(); }
+    size_t memory_usage() const { return sizeof(*this) + tiles.capacity() * sizeof(TileData); }
+    ivec get_tl() const { return tl; }
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+    bool contains(const HexCoords& coords) const {
+        ivec o = coords.get_offset() - tl;
+        return o.x >= 0 and o.x < width and o.y >= 0 and o.y < height;
+    }
+
+    size_t index(const HexCoords& coords) const {
+        ivec o = coords.get_offset() - tl;
+        return o.y * width + o.x;
+    }
+
+    HexCoords coords(size_t index) const {
+        return HexCoords::from_offset(tl.x + int(index % width), tl.y + int(index / width));
+    }
+
+    TileData& at(const HexCoords& coords) { return tiles[index(coords)]; }
+    const TileData& at(const HexCoords& coords) const { return tiles[index(coords)]; }
+    TileData& operator[](size_t index) { return tiles[index]; }
+    const TileData& operator[](size_t index) const { return tiles[index]; }
+
+    Iterator<TileData> begin() { return {tiles.data(), tl, width}; }
+    Iterator<TileData> end() { return {tiles.data() + tiles.size(), tl, width}; }
+    Iterator<const TileData> begin() const { return {tiles.data(), tl, width}; }
+    Iterator<const TileData> end() const { return {tiles.data() + tiles.size(), tl, width}; }
+};
@@ -0,0 +1,156 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "TerrainArray.hpp"
+#include "simd.hpp"
+
+/*
+====================================================================================================
+  ~*~ TerrainGenerator ~*~
+  Procedural terrain: the TileData of a tile is a pure function of the world seed and of its
+  coordinates, so that cells can be generated in any order, in parallel, and regenerated
+  identically after being discarded.
+  Soil type comes from low-frequency value noise, forests from a forest density noise compared to
+  per-tile white noise. Rows of tiles are generated by a batch kernel (see simd.hpp) that gives the
+  same result at every SIMD level.
+==================================================================================================*/
+class TerrainGenerator {
+    uint32_t seed;
+
+    static constexpr float soil_frequency = 1 / 9.f;    // in 1/tiles
+    static constexpr float forest_frequency = 1 / 5.f;  // in 1/tiles
+    static constexpr float row_height = 0.8660254f;     // sqrt(3)/2, hexes are not squares
+    static constexpr float unit = 1 / 16777216.f;       // 2^-24
+
+  public:
+    static constexpr int nb_soil_types = 7;
+
+    SIMD_LANES_BEGIN
+    // integer hash of lattice points (murmur3-like finalizer)
+    template <class L>
+    static SIMD_INLINE typename L::U hash(uint32_t seed, typename L::I x, typename L::I y) {
+        using U = typename L::U;
+        U h = seed ^ ((U)x * 0x9E3779B1u) ^ ((U)y * 0x85EBCA77u);
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // lattice values in [0, 1)
+    template <class L>
+    static SIMD_INLINE typename L::F lattice(uint32_t seed, typename L::I x, typename L::I y) {
+        return L::to_float((typename L::I)(hash<L>(seed, x, y) >> 8)) * unit;
+    }
+
+    // smoothly interpolated value noise in [0, 1)
+    template <class L>
+    static SIMD_INLINE typename L::F value_noise(uint32_t seed, typename L::F x, typename L::F y) {
+        using F = typename L::F;
+        auto ix = L::floor(x), iy = L::floor(y);
+        F tx = x - L::to_float(ix), ty = y - L::to_float(iy);
+        tx = tx * tx * (3.f - 2.f * tx);
+        ty = ty * ty * (3.f - 2.f * ty);
+        F v00 = lattice<L>(seed, ix, iy), v10 = lattice<L>(seed, ix + 1, iy);
+        F v01 = lattice<L>(seed, ix, iy + 1), v11 = lattice<L>(seed, ix + 1, iy + 1);
+        F top = v00 + (v10 - v00) * tx;
+        F bottom = v01 + (v11 - v01) * tx;
+        return top + (bottom - top) * ty;
+    }
+
+    // generates tiles (x0, y) to (x0 + count - 1, y) by batches of L::width, returns the number of
+    // tiles done (the rest is left to a narrower kernel)
+    template <class L>
+    static SIMD_INLINE int generate(uint32_t seed, int x0, int y, int count, TileData* out) {
+        using F = typename L::F;
+        using I = typename L::I;
+        // position in tile units, odd rows are shifted by half a tile
+        float shift = 0.5f * float(y & 1);
+        F py = L::splat(float(y) * row_height);
+        I iy = L::splat(y);
+
+        int i = 0;
+        for (; i + L::width <= count; i += L::width) {
+            I x = L::iota(x0 + i);
+            F px = L::to_float(x) + shift;
+
+            F soil = value_noise<L>(seed, px * soil_frequency, py * soil_frequency);
+            I soil_type = L::min(L::truncate(soil * float(nb_soil_types)),
+                                 L::splat(nb_soil_types - 1));
+
+            F density = value_noise<L>(seed + 1, px * forest_frequency, py * forest_frequency);
+            I not_forest = 1 - L::less(lattice<L>(seed + 2, x, iy), density);
+
+            for (int lane = 0; lane < L::width; lane++) {
+                out[i + lane] = TileData(L::lane(soil_type, lane), L::lane(not_forest, lane));
+            }
+        }
+        return i;
+    }
+    SIMD_LANES_END
+
+#if SIMD_HAS_AVX2
+    SIMD_TARGET_AVX2 static int generate_avx2(uint32_t seed, int x0, int y, int count,
+                                              TileData* out) {
+        return generate<simd::Vector8>(seed, x0, y, count, out);
+    }
+#endif
+
+    TerrainGenerator(uint32_t seed = 0) : seed(seed) {}
+
+    uint32_t get_seed() const { return seed; }
+
+    // tile at offset coordinates (x, y)
+    TileData tile(int x, int y) const {
+        TileData result;
+        generate<simd::Scalar>(seed, x, y, 1, &result);
+        return result;
+    }
+
+    TileData tile(const HexCoords& coords) const {
+        ivec o = coords.get_offset();
+        return tile(o.x, o.y);
+    }
+
+    // tiles (x0, y) to (x0 + count - 1, y), level is only there to test all paths
+    void fill_row(int x0, int y, int count, TileData* out,
+                  simd::Level level = simd::best_level()) const {
+        int done = 0;
+#if SIMD_HAS_AVX2
+        if (level == simd::Level::vector8) {
+            done = generate_avx2(seed, x0, y, count, out);
+        }
+#endif
+        if (level != simd::Level::scalar) {
+            done += generate<simd::Vector4>(seed, x0 + done, y, count - done, out + done);
+        }
+        generate<simd::Scalar>(seed, x0 + done, y, count - done, out + done);
+    }
+
+    void fill(TerrainArray& terrain) const {
+        ivec tl = terrain.get_tl();
+        for (int row = 0; row < terrain.get_height(); row++) {
+            fill_row(tl.x, tl.y + row, terrain.get_width(), &terrain[row * terrain.get_width()]);
+        }
+    }
+};
+
+constexpr int TerrainGenerator::nb_soil_types;
@@ -0,0 +1,152 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include "TextureRegion.hpp"
+#include "globals.hpp"
+
+/*
+====================================================================================================
+  ~*~ TextureAtlas ~*~
+  Packs several images into a few large textures (pages), so that sprites using them can be drawn
+  together, like the terrain tiles in alltiles.png. Images are packed on shelves, tallest first,
+  with transparent padding between them so that filtering does not bleed across images.
+==================================================================================================*/
+class TextureAtlas {
+    vector<TextureHandle> pages;
+    std::map<string, TextureRegion> regions;
+
+  public:
+    struct Placement {
+        int page;
+        ivec position;
+    };
+
+    // places rectangles of the given sizes on pages of at most max_size (rectangles that only fit
+    // without padding get a page of their own, larger ones are rejected with a page of -1); the
+    // used size of each page is output in page_sizes
+    static vector<Placement> pack(const vector<ivec>& sizes, ivec max_size, int padding,
+                                  vector<ivec>& page_sizes) {
+        vector<size_t> order(sizes.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&sizes](size_t a, size_t b) { return sizes[a].y > sizes[b].y; });
+
+        vector<Placement> result(sizes.size());
+        page_sizes.clear();
+        ivec cursor(0, 0);  // on the current shelf
+        int shelf_height = 0;
+        bool page_full = true;
+        for (auto i : order) {
+            ivec size = sizes[i] + ivec(padding, padding);
+            if (sizes[i].x > max_size.x or sizes[i].y > max_size.y) {
+                result[i] = Placement{-1, ivec(0, 0)};
+                continue;
+            }
+            if (size.x > max_size.x or size.y > max_size.y) {
+                result[i] = Placement{int(page_sizes.size()), ivec(0, 0)};
+                page_sizes.emplace_back(std::min(size.x, max_size.x), std::min(size.y, max_size.y));
+                page_full = true;
+                continue;
+            }
+            if (cursor.x + size.x > max_size.x) {  // next shelf
+                cursor = ivec(0, cursor.y + shelf_height);
+                shelf_height = 0;
+            }
+            if (page_full or cursor.y + size.y > max_size.y) {  // next page
+                page_sizes.emplace_back(0, 0);
+                cursor = ivec(0, 0);
+                shelf_height = 0;
+                page_full = false;
+            }
+            result[i] = Placement{int(page_sizes.size()) - 1, cursor};
+            auto& page = page_sizes.back();
+            page = ivec(std::max(page.x, cursor.x + size.x), std::max(page.y, cursor.y + size.y));
+            cursor.x += size.x;
+            shelf_height = std::max(shelf_height, size.y);
+        }
+        return result;
+    }
+
+    // to be called from the render thread; files that cannot be loaded, or are larger than a
+    // texture can be, are left out (with an error message)
+    TextureAtlas(const vector<string>& paths, int max_size = 2048, int padding = 2) {
+        vector<sf::Image> images;
+        vector<string> loaded;
+        vector<ivec> sizes;
+        for (auto& path : paths) {
+            sf::Image image;
+            if (image.loadFromFile(path)) {
+                images.push_back(image);
+                loaded.push_back(path);
+                sizes.emplace_back(image.getSize());
+            }
+        }
+
+        int size_limit = std::min(max_size, int(sf::Texture::getMaximumSize()));
+        vector<ivec> page_sizes;
+        auto placements = pack(sizes, ivec(size_limit, size_limit), padding, page_sizes);
+
+        vector<sf::Image> page_images(page_sizes.size());
+        for (size_t p = 0; p < page_sizes.size(); p++) {
+            page_images[p].create(page_sizes[p].x, page_sizes[p].y, sf::Color::Transparent);
+        }
+        for (size_t i = 0; i < images.size(); i++) {
+            auto& placement = placements[i];
+            if (placement.page < 0) {
+                std::cerr << "Image " << loaded[i] << " is too large for a texture" << std::endl;
+                continue;
+            }
+            page_images[placement.page].copy(images[i], placement.position.x,
+                                             placement.position.y);
+        }
+        vector<bool> page_loaded;
+        for (auto& image : page_images) {
+            auto texture = std::make_shared<sf::Texture>();
+            page_loaded.push_back(texture->loadFromImage(image));
+            pages.push_back(texture);
+        }
+        for (size_t i = 0; i < images.size(); i++) {
+            auto& placement = placements[i];
+            if (placement.page < 0) {
+                continue;
+            }
+            if (!page_loaded[placement.page]) {
+                std::cerr << "Could not create the atlas page of " << loaded[i] << std::endl;
+                continue;
+            }
+            regions[loaded[i]] =
+                TextureRegion(pages[placement.page], sf::IntRect(placement.position, sizes[i]));
+        }
+    }
+
+    bool contains(const string& path) const { return regions.count(path) > 0; }
+    TextureRegion get(const string& path) const { return regions.at(path); }
+
+    const vector<TextureHandle>& get_pages() const { return pages; }
+    size_t size() const { return regions.size(); }
+
+    size_t memory_usage() const {
+        size_t result = 0;
+        for (auto& page : pages) result += size_t(page->getSize().x) * page->getSize().y * 4;
+        return result;
+    }
+};
@@ -0,0 +1,39 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <memory>
+#include "globals.hpp"
+
+using TextureHandle = std::shared_ptr<const sf::Texture>;
+
+/*
+====================================================================================================
+  ~*~ TextureRegion ~*~
+  A shared texture and the rectangle of it to use, either a whole texture or an image in an atlas.
+==================================================================================================*/
+struct TextureRegion {
+    TextureHandle texture;
+    sf::IntRect rect;
+
+    TextureRegion() = default;
+    TextureRegion(TextureHandle texture)
+        : texture(texture), rect(ivec(0, 0), ivec(texture->getSize())) {}
+    TextureRegion(TextureHandle texture, sf::IntRect rect) : texture(texture), rect(rect) {}
+
+    ivec get_size() const { return ivec(rect.width, rect.height); }
+    vec get_origin() const { return vec(rect.left, rect.top); }
+};
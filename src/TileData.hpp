@@ -15,11 +15,24 @@
 
 #pragma once
 
+#include <cstdint>
 #include <utility>
+#include "HexCoords.hpp"
 
 /*
 ====================================================================================================
   ~*~ TileData ~*~
   Contains all terrain-related info for a given tile (type of soil, doodads...).
 ==================================================================================================*/
-using TileData = std::pair<int, int>;  // soil type, is not a forest
+using TileData = std::pair<uint8_t, uint8_t>;  // soil type, is not a forest (packed in 2 bytes)
+
+/*
+====================================================================================================
+  ~*~ TerrainSource ~*~
+  Anything that can tell the terrain of any tile, e.g. for pathfinding.
+==================================================================================================*/
+class TerrainSource {
+  public:
+    virtual ~TerrainSource() = default;
+    virtual TileData terrain_at(const HexCoords& coords) const = 0;
+};
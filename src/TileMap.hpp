@@ -15,44 +15,111 @@
 
 #pragma once
 
+#include <array>
+#include "HexBatch.hpp"
 #include "HexCoords.hpp"
-#include "TileData.hpp"
+#include "ResourceManager.hpp"
+#include "TerrainArray.hpp"
+#include "TerrainGenerator.hpp"
 #include "globals.hpp"
 
+/*
+====================================================================================================
+  ~*~ TilePalette ~*~
+  Average colour of each soil tile of the tileset (and of trees), to draw the terrain as flat
+  colours when zoomed out.
+==================================================================================================*/
+struct TilePalette {
+    std::array<sf::Color, TerrainGenerator::nb_soil_types> soils;
+    sf::Color forest;
+
+    // average of the pixels in rect, weighted by alpha; to be called from the render thread
+    static sf::Color average(const sf::Image& image, sf::IntRect rect) {
+        double r = 0, g = 0, b = 0, a = 0;
+        for (int x = rect.left; x < rect.left + rect.width; x++) {
+            for (int y = rect.top; y < rect.top + rect.height; y++) {
+                sf::Color c = image.getPixel(x, y);
+                r += c.r * c.a;
+                g += c.g * c.a;
+                b += c.b * c.a;
+                a += c.a;
+            }
+        }
+        return a > 0 ? sf::Color(r / a, g / a, b / a) : sf::Color::Black;
+    }
+};
+
 /*
 ====================================================================================================
   ~*~ TileMap ~*~
+  Geometry is built in client memory by load() (from any thread) and can then be uploaded once to a
+  static GPU vertex buffer by upload() (from the render thread), instead of being sent again on
+  every draw. Without vertex buffer support, the client-side array is drawn.
 ==================================================================================================*/
 class TileMap : public GameObject {
-    sf::Texture tileset;
+    TextureHandle tileset;
     sf::VertexArray array;
+    sf::VertexBuffer buffer{sf::Quads, sf::VertexBuffer::Static};
+    bool uploaded{false};
     int w{144};
 
+    static constexpr int tile_width = 258, tile_height = 193;
+
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
         states.transform *= getTransform();
-        states.texture = &tileset;
-        target.draw(array, states);
+        states.texture = tileset.get();
+        if (uploaded) {
+            target.draw(buffer, states);
+        } else {
+            target.draw(array, states);
+        }
     }
 
   public:
-    TileMap(string tileset_name = "png/alltiles.png") {
-        tileset.loadFromFile(tileset_name);
-        array.setPrimitiveType(sf::Quads);
+    TileMap(TextureHandle tileset) : tileset(tileset) { array.setPrimitiveType(sf::Quads); }
+
+    static TilePalette palette(const sf::Texture& tileset, const TextureRegion& tree) {
+        TilePalette result;
+        sf::Image tiles = tileset.copyToImage();
+        for (int i = 0; i < TerrainGenerator::nb_soil_types; i++) {
+            result.soils[i] = TilePalette::average(
+                tiles, sf::IntRect(0, i * tile_height, tile_width, tile_height));
+        }
+        result.forest = TilePalette::average(tree.texture->copyToImage(), tree.rect);
+        return result;
+    }
+
+    sf::FloatRect get_bounds() const { return array.getBounds(); }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + array.getVertexCount() * sizeof(sf::Vertex);
+    }
+
+    // to be called from the render thread, after load
+    void upload() {
+        uploaded = sf::VertexBuffer::isAvailable() and array.getVertexCount() > 0 and
+                   buffer.create(array.getVertexCount()) and buffer.update(&array[0]);
     }
 
-    void load(const std::unordered_map<HexCoords, TileData>& grid) {
+    void load(const TerrainArray& grid) {
+        uploaded = false;
         array.resize(grid.size() * 4);
 
-        auto it = grid.begin();  // needs iteration with index
+        vector<HexCoords> hexes(grid.size());
+        vector<vec> centers(grid.size());
+        for (size_t i = 0; i < grid.size(); i++) {
+            hexes[i] = grid.coords(i);
+        }
+        hex_batch::to_pixels(w, hexes.data(), hexes.size(), centers.data());
+
         int i = 0;
-        while (it != grid.end()) {
-            auto hex_coords = it->first;
-            auto tile_type = it->second;
+        for (auto&& tile : grid) {
+            auto tile_type = tile.second;
 
             sf::Vertex* quad = &array[i * 4];
-            vec tile_dim{258, 193};
+            vec tile_dim{tile_width, tile_height};
             vec tile_center{109, 88};
-            vec hex_center = hex_coords.get_pixel(w);
+            vec hex_center = centers[i];
             vec tl = hex_center - tile_center;
             vec br = tl + tile_dim;
             vec tex_tl = vec{0, tile_type.first * tile_dim.y};
@@ -75,7 +142,6 @@ class TileMap : public GameObject {
                 quad[2].color = sf::Color::White;
                 quad[3].color = sf::Color::White;
             }
-            it++;
             i++;
         }
     }
@@ -16,6 +16,7 @@
 #pragma once
 
 #include "HexCoords.hpp"
+#include "OffsetRect.hpp"
 #include "View.hpp"
 #include "Window.hpp"
 #include "globals.hpp"
@@ -28,7 +29,7 @@ class ViewController : public Component {
     bool mouse_pressed{false};
     int mouse_x{0}, mouse_y{0};
     View *main_view, *interface_view;
-    HexCoords ctl, cbr;
+    ViewDiff visible;
 
     Window* window;
 
@@ -84,11 +85,17 @@ class ViewController : public Component {
             mouse_x = mouse_pos.x;
             mouse_y = mouse_pos.y;
         }
+
+        // visible hexes, with a margin of one hex so that partially visible hexes are included
         vec dim = main_view->get().getSize();
         vec center = main_view->get().getCenter();
         vec tl = center - dim / 2;
         vec br = tl + dim;
-        return !(HexCoords::from_pixel(w, tl) == ctl) or !(HexCoords::from_pixel(w, br) == cbr);
+        ivec margin(1, 1);
+        visible.previous = visible.current;
+        visible.current = OffsetRect(HexCoords::from_pixel(w, tl).get_offset() - margin,
+                                     HexCoords::from_pixel(w, br).get_offset() + margin);
+        return visible.changed();
     }
 
     vec get_mouse_position() {
@@ -96,23 +103,12 @@ class ViewController : public Component {
     }
 
     vec get_window_size() { return vec(window->width, window->height); }
+    vec get_view_center() { return main_view->get().getCenter(); }
+    vec get_view_size() { return main_view->get().getSize(); }
 
-    vector<HexCoords> get_visible_coords(int w) {
-        // gather relevant view coordinates
-        vec dim = main_view->get().getSize();
-        vec center = main_view->get().getCenter();
-        vec tl = center - dim / 2;
-        vec br = tl + dim;
-
-        vector<HexCoords> result;
+    // world pixels per screen pixel
+    scalar get_scale() { return main_view->get().getSize().x / window->width; }
 
-        ctl = HexCoords::from_pixel(w, tl);
-        cbr = HexCoords::from_pixel(w, br);
-        for (int i = ctl.get_offset().x - 1; i <= cbr.get_offset().x + 1; i++) {
-            for (int j = ctl.get_offset().y - 1; j <= cbr.get_offset().y + 1; j++) {
-                result.push_back(HexCoords::from_offset(i, j));
-            }
-        }
-        return result;
-    }
+    // visible rectangle as computed by the last update, and what entered/exited it
+    const ViewDiff& get_visible_range() const { return visible; }
 };
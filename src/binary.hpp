@@ -0,0 +1,46 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <cstdint>
+
+/*
+====================================================================================================
+  ~*~ binary helpers ~*~
+  Fixed-size little-endian integer encoding, independent of the host byte order.
+==================================================================================================*/
+namespace binary {
+    inline void write_u16(char* p, uint16_t v) {
+        p[0] = char(v & 0xFF);
+        p[1] = char(v >> 8);
+    }
+
+    inline void write_u32(char* p, uint32_t v) {
+        write_u16(p, uint16_t(v & 0xFFFF));
+        write_u16(p + 2, uint16_t(v >> 16));
+    }
+
+    inline uint16_t read_u16(const char* p) {
+        return uint16_t(uint8_t(p[0]) | (uint8_t(p[1]) << 8));
+    }
+
+    inline uint32_t read_u32(const char* p) {
+        return uint32_t(read_u16(p)) | (uint32_t(read_u16(p + 2)) << 16);
+    }
+
+    inline void write_i32(char* p, int32_t v) { write_u32(p, uint32_t(v)); }
+    inline int32_t read_i32(const char* p) { return int32_t(read_u32(p)); }
+}  // namespace binary
@@ -15,9 +15,11 @@
 
 #include <memory>
 #include "CellGrid.hpp"
+#include "Crowd.hpp"
 #include "HexGrid.hpp"
 #include "Interface.hpp"
 #include "Layer.hpp"
+#include "Pathfinder.hpp"
 #include "TileMap.hpp"
 #include "ViewController.hpp"
 #include "connectors.hpp"
@@ -25,6 +27,8 @@
 
 using namespace std;
 
+const scalar hex_width = 144;  // in pixels
+
 /*
 ====================================================================================================
   ~*~ MainMode ~*~
@@ -33,14 +37,12 @@ using namespace std;
 class MainMode : public Component {
     HexCoords cursor_coords, last_click_coords;
     bool toggle_grid{true};
-    scalar w = 144;
-    vector<HexCoords> hexes_to_draw;
-    vector<unique_ptr<Person>> persons;
+    Detail detail{Detail::full};
+    scalar w = hex_width;
+    ViewDiff visible_cells;
     vector<unique_ptr<SimpleObject>> menhirs;
     vector<unique_ptr<Faith>> faith;
 
-    vector<unique_ptr<Person>>* provide_persons() { return &persons; }
-
     // use ports
     Window* window;
     ViewController* view_controller;
@@ -48,32 +50,40 @@ class MainMode : public Component {
     Interface* interface;
     Layer* object_layer;
     CellGrid* cell_grid;
+    ResourceManager* resources;
+    Crowd* crowd;
+    Pathfinder* pathfinder;
+
+    int nb_villagers;
 
     int selected_tool{1};
 
+    bool show_grid() const { return toggle_grid and detail == Detail::full; }
+
   public:
-    MainMode() {
-        provide("persons", &MainMode::provide_persons);
+    MainMode(int nb_villagers = 4) : nb_villagers(nb_villagers) {
         port("window", &MainMode::window);
         port("view", &MainMode::view_controller);
         port("grid", &MainMode::grid);
         port("interface", &MainMode::interface);
         port("objectLayer", &MainMode::object_layer);
         port("cellGrid", &MainMode::cell_grid);
+        port("resources", &MainMode::resources);
+        port("crowd", &MainMode::crowd);
+        port("pathfinder", &MainMode::pathfinder);
+    }
 
-        for (int i = 0; i < 4; i++) {
-            persons.emplace_back(new Person(w));
-            persons.back()->teleport_to(HexCoords(0, 0, 0));
+    void init() {
+        grid->highlight(w, cursor_coords);
+        for (int i = 0; i < nb_villagers; i++) {
+            crowd->add(HexCoords::from_offset(rand() % 21 - 10, rand() % 21 - 10));
         }
     }
 
-    void init() {}
-
     void load() {
         view_controller->update(w);
-        auto hexes_to_draw = view_controller->get_visible_coords(w);
-        // terrain->load(w, hexes_to_draw); // FIXME
-        grid->load(w, hexes_to_draw, cursor_coords, toggle_grid);
+        grid->load(w, view_controller->get_visible_range().current, show_grid());
+        grid->highlight(w, cursor_coords);
     }
 
     bool process_event(sf::Event event) {
@@ -81,7 +91,20 @@ class MainMode : public Component {
 
         if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::G) {
             toggle_grid = !toggle_grid;
-            grid->load(w, hexes_to_draw, cursor_coords, toggle_grid);
+            grid->load(w, view_controller->get_visible_range().current, show_grid());
+
+        } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R) {
+            resources->report(cout);
+            auto& stats = cell_grid->get_prefetch_stats();
+            cout << "Prefetch: " << stats.requested << " cells requested, " << stats.hits
+                 << " hits, " << stats.misses << " misses\n";
+            cout << "Cell textures: " << (cell_grid->get_texture_usage() >> 20) << " MiB\n";
+            auto& paths = pathfinder->get_stats();
+            unsigned searches = paths.queries + paths.flow_fields;
+            cout << "Paths: " << paths.queries << " queries, " << paths.flow_fields
+                 << " flow fields (" << paths.failures << " failed), " << paths.expanded
+                 << " nodes, " << paths.total_ms / std::max(searches, 1u) << " ms average, "
+                 << paths.max_ms << " ms max\n";
 
         } else if (event.type == sf::Event::KeyPressed) {
             switch (event.key.code) {
@@ -109,30 +132,27 @@ class MainMode : public Component {
         } else if (event.type == sf::Event::MouseButtonPressed and
                    event.mouseButton.button == sf::Mouse::Right) {
             cursor_coords = HexCoords::from_pixel(w, pos);
-            grid->load(w, hexes_to_draw, cursor_coords, toggle_grid);
-            for (auto& p : persons) {
-                p->go_to(cursor_coords);
-            }
+            grid->highlight(w, cursor_coords);
+            crowd->go_to(cursor_coords);
 
         } else if (event.type == sf::Event::MouseButtonPressed and
                    event.mouseButton.button == sf::Mouse::Left) {
             last_click_coords = HexCoords::from_pixel(w, pos);
             if (selected_tool == 1) {
-                if (rand() % 2 == 0)
-                    menhirs.emplace_back(
-                        new SimpleObject(w, "png/menhir.png", last_click_coords, 0.5));
-                else
-                    menhirs.emplace_back(
-                        new SimpleObject(w, "png/menhir2.png", last_click_coords, 0.5));
+                auto texture = resources->get_sprite(rand() % 2 == 0 ? "png/menhir.png"
+                                                                      : "png/menhir2.png");
+                menhirs.emplace_back(new SimpleObject(w, texture, last_click_coords, 0.5));
                 object_layer->add_object(menhirs.back().get());
             } else if (selected_tool == 2) {
-                faith.emplace_back(new Faith(w, last_click_coords));
-                object_layer->add_object(faith.back().get());
+                faith.emplace_back(new Faith(w, *resources, last_click_coords));
+                object_layer->add_mobile_object(faith.back().get());
             } else if (selected_tool == 3) {
-                menhirs.emplace_back(new SimpleObject(w, "png/altar.png", last_click_coords, 0.2));
+                menhirs.emplace_back(new SimpleObject(w, resources->get_sprite("png/altar.png"),
+                                                      last_click_coords, 0.2));
                 object_layer->add_object(menhirs.back().get());
             } else if (selected_tool == 4) {
-                menhirs.emplace_back(new SimpleObject(w, "png/tree1.png", last_click_coords, 0.5));
+                menhirs.emplace_back(new SimpleObject(w, resources->get_sprite("png/tree1.png"),
+                                                      last_click_coords, 0.5));
                 object_layer->add_object(menhirs.back().get());
             }
 
@@ -145,29 +165,33 @@ class MainMode : public Component {
 
     void before_draw(sf::Time elapsed_time, scalar fps) {
         interface->before_draw(view_controller->get_window_size(), fps);
+        cell_grid->receive_cells();
 
         vec pos = view_controller->get_mouse_position();
         if (view_controller->update(w)) {
-            hexes_to_draw = view_controller->get_visible_coords(w);
-            grid->load(w, hexes_to_draw, cursor_coords, toggle_grid);
-
-            // HACK
-            ivec tl = hexes_to_draw.front().get_offset();
-            ivec br = hexes_to_draw.back().get_offset();
-            auto floor = [](int i) { return i < 0 ? (i / 20) - 1 : i / 20; };
-            ivec ctl{floor(tl.x), floor(tl.y)};
-            ivec cbr{floor(br.x), floor(br.y)};
-            cout << ctl.x << ", " << ctl.y << " | " << cbr.x << ", " << cbr.y << endl;
-            for (int x = ctl.x; x <= cbr.x; x++) {
-                for (int y = ctl.y; y <= cbr.y; y++) {
-                    cell_grid->add_cell(ivec(x, y));
+            auto& visible = view_controller->get_visible_range();
+            detail = detail_at_scale(view_controller->get_scale());
+            cell_grid->set_detail(detail);
+            grid->load(w, visible, show_grid());
+
+            // cells covering the visible hexes; only the ones that just came into view are
+            // requested (add_cell ignores cells that are already there)
+            visible_cells.previous = visible_cells.current;
+            visible_cells.current = OffsetRect(cell_grid->cell_of(visible.current.tl),
+                                               cell_grid->cell_of(visible.current.br));
+            if (visible_cells.changed()) {
+                for (auto& rect : visible_cells.entered()) {
+                    for (auto c : rect) {
+                        cell_grid->add_cell(c.get_offset());
+                    }
                 }
             }
         }
+        cell_grid->update_visibility(visible_cells.current);
+        cell_grid->track_camera(view_controller->get_view_center(),
+                                view_controller->get_view_size(), elapsed_time.asSeconds());
 
-        for (auto& person : persons) {
-            person->animate(elapsed_time.asSeconds());
-        }
+        crowd->animate(elapsed_time.asSeconds());
         for (auto& f : faith) {
             f->set_target(pos);
             f->animate(elapsed_time.asSeconds());
@@ -242,12 +266,20 @@ class MainLoop : public Component {
     }
 };
 
+// images of objects and icons, packed in a texture atlas
+const vector<string> object_sprites{
+    "png/altar.png",    "png/clothes1.png", "png/clothes2.png", "png/clothes3.png",
+    "png/faith.png",    "png/menhir.png",   "png/menhir2.png",  "png/people1.png",
+    "png/people2.png",  "png/people3.png",  "png/tree1.png"};
+
 /*
 ====================================================================================================
   ~*~ main ~*~
+  Usage: game_bin [number of villagers, 4 by default]
 ==================================================================================================*/
-int main() {
+int main(int argc, char** argv) {
     srand(time(NULL));
+    int nb_villagers = argc > 1 ? std::max(atoi(argv[1]), 0) : 4;
 
     Model model;
 
@@ -265,25 +297,36 @@ int main() {
     model.component<Layer>("terrainlayer")
         .connect<Use<GameObject>>("objects", "cellGrid")
         .connect<Use<View>>("view", "mainview");
-    model.component<Layer>("personlayer")
-        .connect<UseObjectVector<Person>>("objects", PortAddress("persons", "mainmode"))
+    model.component<Layer>("personlayer", hex_width)
+        .connect<Use<SpriteStream>>("streams", "crowd")
         .connect<Use<View>>("view", "mainview");
+    model.component<Crowd>("crowd", hex_width)
+        .connect<Use<ResourceManager>>("resources", "resources")
+        .connect<Use<View>>("view", "mainview")
+        .connect<Use<Pathfinder>>("pathfinder", "pathfinder");
+    model.component<Pathfinder>("pathfinder").connect<Use<TerrainSource>>("terrain", "cellGrid");
     model.component<Layer>("interfacelayer")
         .connect<Use<GameObject>>("objects", "interface")
         .connect<Use<View>>("view", "interfaceview");
 
-    model.component<MainMode>("mainmode")
+    model.component<MainMode>("mainmode", nb_villagers)
         .connect<Use<Window>>("window", "window")
         .connect<Use<HexGrid>>("grid", "grid")
         .connect<Use<ViewController>>("view", "viewcontroller")
         .connect<Use<Layer>>("objectLayer", "personlayer")
         .connect<Use<Interface>>("interface", "interface")
-        .connect<Use<CellGrid>>("cellGrid", "cellGrid");
+        .connect<Use<CellGrid>>("cellGrid", "cellGrid")
+        .connect<Use<Crowd>>("crowd", "crowd")
+        .connect<Use<Pathfinder>>("pathfinder", "pathfinder")
+        .connect<Use<ResourceManager>>("resources", "resources");
 
     model.component<Window>("window");
+    model.component<ResourceManager>("resources", object_sprites);
     model.component<HexGrid>("grid");
-    model.component<Interface>("interface");
-    model.component<CellGrid>("cellGrid");
+    model.component<Interface>("interface")
+        .connect<Use<ResourceManager>>("resources", "resources");
+    model.component<CellGrid>("cellGrid")
+        .connect<Use<ResourceManager>>("resources", "resources");
 
     model.component<View>("mainview").connect<Use<Window>>("window", "window");
     model.component<View>("interfaceview", true).connect<Use<Window>>("window", "window");
@@ -47,8 +47,13 @@ using sf::Drawable;
 ====================================================================================================
   ~*~ virtual interfaces ~*~
 ==================================================================================================*/
+class SpriteBatch;
+
 struct GameObject : public Drawable, public sf::Transformable {
     virtual void animate(scalar) {}
+
+    // adds the object's sprites to the batch instead of drawing it, if it is made of sprites only
+    virtual bool batch(SpriteBatch&) const { return false; }
 };
 
 /*
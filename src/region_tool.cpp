@@ -0,0 +1,139 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#include <dirent.h>
+#include <cstdio>
+#include <fstream>
+#include "Cell.hpp"
+#include "CellStore.hpp"
+
+using namespace std;
+
+/*
+====================================================================================================
+  ~*~ region_tool ~*~
+  Converts a world directory between region files (used by the game) and one file per cell
+  (cell_x_y.bin, easy to inspect or edit). Unpacking then packing a world compacts its regions.
+==================================================================================================*/
+string cell_path(const string& directory, ivec cell) {
+    return directory + "/cell_" + to_string(cell.x) + "_" + to_string(cell.y) + ".bin";
+}
+
+// calls f(ivec coords, string filename) for every file named <prefix>_x_y.bin
+template <class F>
+void for_each_file(const string& directory, const string& prefix, F f) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        cerr << "Could not open " << directory << endl;
+        return;
+    }
+    string pattern = prefix + "_%d_%d.bin%n";
+    while (dirent* e = readdir(dir)) {
+        int x, y, length = 0;
+        string name = e->d_name;
+        if (sscanf(name.c_str(), pattern.c_str(), &x, &y, &length) == 2 and
+            length == int(name.size())) {
+            f(ivec(x, y), directory + "/" + name);
+        }
+    }
+    closedir(dir);
+}
+
+void pack(const string& directory) {
+    CellStore store(directory);
+    int nb_cells = 0;
+    for_each_file(directory, "cell", [&](ivec cell, const string& path) {
+        ifstream file(path, ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (!CellState::check(data.data(), data.size())) {
+            cerr << "Skipping invalid cell file " << path << endl;
+            return;
+        }
+        store.save(cell, data);
+        if (!store.flush(cell)) {
+            cerr << "Keeping " << path << endl;
+            return;
+        }
+        remove(path.c_str());
+        nb_cells++;
+    });
+    cout << "Packed " << nb_cells << " cells." << endl;
+}
+
+void unpack(const string& directory) {
+    int nb_cells = 0;
+    for_each_file(directory, "region", [&](ivec region, const string& path) {
+        bool written = true;
+        {
+            RegionFile file(path);
+            if (!file.is_valid()) {
+                cerr << "Skipping invalid region file " << path << endl;
+                return;
+            }
+            file.for_each([&](ivec local, const char* data, size_t size) {
+                string cell_file = cell_path(directory, region * RegionFile::region_size + local);
+                ofstream out(cell_file, ios::binary);
+                out.write(data, size);
+                out.close();
+                if (!out.good()) {
+                    cerr << "Could not write " << cell_file << endl;
+                    written = false;
+                    return;
+                }
+                nb_cells++;
+            });
+        }
+        if (written) {
+            remove(path.c_str());
+        } else {
+            cerr << "Keeping " << path << endl;
+        }
+    });
+    cout << "Unpacked " << nb_cells << " cells." << endl;
+}
+
+void info(const string& directory) {
+    for_each_file(directory, "region", [&](ivec region, const string& path) {
+        RegionFile file(path);
+        if (!file.is_valid()) {
+            cout << region.x << ", " << region.y << ": invalid" << endl;
+            return;
+        }
+        int nb_cells = 0;
+        size_t data_size = 0;
+        file.for_each([&](ivec, const char*, size_t size) {
+            nb_cells++;
+            data_size += size;
+        });
+        cout << region.x << ", " << region.y << ": " << nb_cells << " cells, "
+             << file.get_file_size() << " bytes ("
+             << file.get_file_size() - RegionFile::header_size - data_size << " unused)" << endl;
+    });
+}
+
+int main(int argc, char** argv) {
+    string command = argc > 1 ? argv[1] : "";
+    string directory = argc > 2 ? argv[2] : "world";
+    if (command == "pack") {
+        pack(directory);
+    } else if (command == "unpack") {
+        unpack(directory);
+    } else if (command == "info") {
+        info(directory);
+    } else {
+        cerr << "Usage: " << argv[0] << " pack|unpack|info [world directory]" << endl;
+        return 1;
+    }
+}
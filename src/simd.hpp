@@ -0,0 +1,123 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/*
+====================================================================================================
+  ~*~ SIMD lanes ~*~
+  Batch kernels are written once as templates over a "lanes" type (Scalar, Vector4 or Vector8)
+  using GCC/Clang vector extensions, so that all paths perform exactly the same operations and give
+  bit-identical results. Vector4 compiles to SSE2 on x86-64 (NEON on ARM); Vector8 is meant to be
+  instantiated from functions marked SIMD_TARGET_AVX2 and selected at runtime with best_level().
+  Everything a kernel calls must be SIMD_INLINE so that it is compiled for the caller's target
+  (which is also why -Wpsabi is silenced around lane code, see SIMD_LANES_BEGIN: 32-byte vectors
+  never cross a real call).
+==================================================================================================*/
+#define SIMD_INLINE inline __attribute__((always_inline))
+#define SIMD_LANES_BEGIN \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wpsabi\"")
+#define SIMD_LANES_END _Pragma("GCC diagnostic pop")
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_HAS_AVX2 1
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_HAS_AVX2 0
+#endif
+
+namespace simd {
+    enum class Level { scalar, vector4, vector8 };
+
+    inline Level best_level() {
+#if SIMD_HAS_AVX2
+        static bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2 ? Level::vector8 : Level::vector4;
+#else
+        return Level::vector4;
+#endif
+    }
+
+    struct Scalar {
+        using F = float;
+        using I = int32_t;
+        using U = uint32_t;
+        static const int width = 1;
+
+        static SIMD_INLINE F splat(float f) { return f; }
+        static SIMD_INLINE I splat(int i) { return i; }
+        static SIMD_INLINE I iota(int start) { return start; }
+        static SIMD_INLINE F to_float(I i) { return F(i); }
+        static SIMD_INLINE I truncate(F f) { return I(f); }
+        static SIMD_INLINE I floor(F f) { return I(std::floor(f)); }
+        static SIMD_INLINE I less(F a, F b) { return a < b ? 1 : 0; }
+        static SIMD_INLINE I greater_mask(F a, F b) { return a > b ? -1 : 0; }
+        static SIMD_INLINE I select(I mask, I a, I b) { return mask ? a : b; }
+        static SIMD_INLINE I min(I a, I b) { return a < b ? a : b; }
+        static SIMD_INLINE F abs(F f) { return f < 0 ? -f : f; }
+        static SIMD_INLINE I round(F f) { return floor(f + 0.5f); }
+        static SIMD_INLINE F lane(F v, int) { return v; }
+        static SIMD_INLINE I lane(I v, int) { return v; }
+        static SIMD_INLINE void set_lane(F& v, int, float f) { v = f; }
+        static SIMD_INLINE void set_lane(I& v, int, int32_t i) { v = i; }
+    };
+
+    SIMD_LANES_BEGIN
+    template <class F_, class I_, class U_, int N>
+    struct Vector {
+        using F = F_;
+        using I = I_;
+        using U = U_;
+        static const int width = N;
+
+        static SIMD_INLINE F splat(float f) { return F{} + f; }
+        static SIMD_INLINE I splat(int i) { return I{} + i; }
+        static SIMD_INLINE I iota(int start) {
+            I result;
+            for (int i = 0; i < N; i++) result[i] = start + i;
+            return result;
+        }
+        static SIMD_INLINE F to_float(I i) { return __builtin_convertvector(i, F); }
+        static SIMD_INLINE I truncate(F f) { return __builtin_convertvector(f, I); }
+        static SIMD_INLINE I floor(F f) {
+            I i = truncate(f);
+            return i + (to_float(i) > f);  // comparisons give -1 where true
+        }
+        static SIMD_INLINE I less(F a, F b) { return (a < b) & 1; }
+        static SIMD_INLINE I greater_mask(F a, F b) { return a > b; }  // -1 where true
+        static SIMD_INLINE I select(I mask, I a, I b) { return mask ? a : b; }
+        static SIMD_INLINE I min(I a, I b) { return a < b ? a : b; }
+        static SIMD_INLINE F abs(F f) { return f < 0 ? -f : f; }
+        static SIMD_INLINE I round(F f) { return floor(f + 0.5f); }  // halves go up
+        static SIMD_INLINE float lane(F v, int i) { return v[i]; }
+        static SIMD_INLINE int32_t lane(I v, int i) { return v[i]; }
+        static SIMD_INLINE void set_lane(F& v, int i, float f) { v[i] = f; }
+        static SIMD_INLINE void set_lane(I& v, int i, int32_t value) { v[i] = value; }
+    };
+
+    typedef float f32x4 __attribute__((vector_size(16)));
+    typedef int32_t i32x4 __attribute__((vector_size(16)));
+    typedef uint32_t u32x4 __attribute__((vector_size(16)));
+    typedef float f32x8 __attribute__((vector_size(32)));
+    typedef int32_t i32x8 __attribute__((vector_size(32)));
+    typedef uint32_t u32x8 __attribute__((vector_size(32)));
+
+    using Vector4 = Vector<f32x4, i32x4, u32x4, 4>;
+    using Vector8 = Vector<f32x8, i32x8, u32x8, 8>;
+    SIMD_LANES_END
+}  // namespace simd
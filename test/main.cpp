@@ -13,5 +13,10 @@
   You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
   not, see <http://www.gnu.org/licenses/>.*/
 
+// the batch tests force every AVX2 kernel to be instantiated; GCC lowers those at the end of the
+// translation unit, outside the SIMD_LANES_BEGIN/END regions, hence the file-wide -Wpsabi silence
+#pragma GCC diagnostic ignored "-Wpsabi"
+
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "misc.hpp"
+#include "world.hpp"
@@ -13,7 +13,11 @@
   You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
   not, see <http://www.gnu.org/licenses/>.*/
 
+#include <thread>
+#include "../src/Crowd.hpp"
 #include "../src/GameEntity.hpp"
+#include "../src/LockFreeQueue.hpp"
+#include "../src/TextureAtlas.hpp"
 #include "doctest.h"
 
 /*
@@ -71,3 +75,103 @@ TEST_CASE("Basic GameEntity test.") {
     entity.draw(render, "other");
     CHECK(ss.str() == "other:119");
 }
+
+/*
+====================================================================================================
+  ~*~ LockFreeQueue ~*~
+==================================================================================================*/
+TEST_CASE("LockFreeQueue with several producers.") {
+    LockFreeQueue<int> queue;
+    vector<std::thread> producers;
+    for (int p = 0; p < 4; p++) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < 1000; i++) {
+                queue.push(p * 1000 + i);
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    vector<int> last(4, -1);  // order is preserved for each producer
+    int value, count = 0;
+    while (queue.pop(value)) {
+        CHECK(value % 1000 > last[value / 1000]);
+        last[value / 1000] = value % 1000;
+        count++;
+    }
+    CHECK(count == 4000);
+}
+
+/*
+====================================================================================================
+  ~*~ TextureAtlas ~*~
+==================================================================================================*/
+TEST_CASE("TextureAtlas packing does not overlap and fits in pages.") {
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> dist(10, 300);
+    vector<ivec> sizes;
+    for (int i = 0; i < 60; i++) {
+        sizes.emplace_back(dist(gen), dist(gen));
+    }
+    sizes.emplace_back(1023, 20);  // only fits without padding
+    sizes.emplace_back(1500, 20);  // larger than a page
+
+    vector<ivec> pages;
+    auto placements = TextureAtlas::pack(sizes, ivec(1024, 1024), 2, pages);
+    CHECK(pages.size() > 1);
+    CHECK(placements.back().page == -1);
+    sizes.pop_back();
+    for (auto& page : pages) {
+        CHECK(page.x <= 1024);
+        CHECK(page.y <= 1024);
+    }
+    for (size_t i = 0; i < sizes.size(); i++) {
+        auto& a = placements[i];
+        CHECK(a.position.x + sizes[i].x <= pages[a.page].x);
+        CHECK(a.position.y + sizes[i].y <= pages[a.page].y);
+        for (size_t j = 0; j < i; j++) {
+            auto& b = placements[j];
+            bool apart = a.page != b.page or a.position.x + sizes[i].x <= b.position.x or
+                         b.position.x + sizes[j].x <= a.position.x or
+                         a.position.y + sizes[i].y <= b.position.y or
+                         b.position.y + sizes[j].y <= a.position.y;
+            CHECK(apart);
+        }
+    }
+}
+
+/*
+====================================================================================================
+  ~*~ Crowd ~*~
+==================================================================================================*/
+TEST_CASE("Crowd villagers reach their destination and stay sorted by y.") {
+    scalar w = 144;
+    Crowd crowd(w, 3);
+    for (int i = 0; i < 200; i++) {
+        crowd.add(HexCoords::from_offset(i % 7 - 3, i % 11 - 5));
+    }
+    auto sorted = [&crowd]() {
+        auto& order = crowd.get_order();
+        for (size_t i = 1; i < order.size(); i++) {
+            if (crowd.get_position(order[i]).y < crowd.get_position(order[i - 1]).y) {
+                return false;
+            }
+        }
+        return order.size() == crowd.size();
+    };
+
+    auto destination = HexCoords::from_offset(6, -4);
+    crowd.go_to(destination);  // no pathfinder, villagers walk straight
+    for (int frame = 0; frame < 1000; frame++) {
+        crowd.animate(0.05);
+        if (frame % 100 == 0) {
+            CHECK(sorted());
+        }
+    }
+    CHECK(sorted());
+    for (size_t i = 0; i < crowd.size(); i++) {
+        CHECK(HexCoords::from_pixel(w, crowd.get_position(i)) == destination);
+    }
+}
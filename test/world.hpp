@@ -0,0 +1,411 @@
+/*Copyright Vincent Lanore 2017-2018
+
+  This file is part of Menhyr.
+
+  Menhyr is free software: you can redistribute it and/or modify it under the terms of the GNU
+  Lesser General Public License as published by the Free Software Foundation, either version 3 of
+  the License, or (at your option) any later version.
+
+  Menhyr is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License along with Menhyr. If
+  not, see <http://www.gnu.org/licenses/>.*/
+
+#include <stdlib.h>
+#include <set>
+#include <unordered_set>
+#include "../src/Cell.hpp"
+#include "../src/CellStore.hpp"
+#include "../src/FlowField.hpp"
+#include "../src/HexBatch.hpp"
+#include "../src/HexTopology.hpp"
+#include "../src/OffsetRect.hpp"
+#include "../src/Pathfinder.hpp"
+#include "../src/TerrainArray.hpp"
+#include "doctest.h"
+
+/*
+====================================================================================================
+  ~*~ HexCoords ~*~
+==================================================================================================*/
+TEST_CASE("HexCoords is compact and hashes neighbours apart.") {
+    static_assert(sizeof(HexCoords) == 2 * sizeof(int), "HexCoords should only store x and y");
+    constexpr HexCoords c = HexCoords::from_offset(3, -5);
+    static_assert(c == HexCoords::from_axial(6, -5), "offset to axial conversion");
+    CHECK(c.get_cube() == cube(6, -5, -1));
+
+    // a square of neighbouring hexes should spread over the buckets of a hash table
+    std::unordered_set<HexCoords> set;
+    for (int x = -50; x < 50; x++) {
+        for (int y = -50; y < 50; y++) {
+            set.insert(HexCoords::from_offset(x, y));
+        }
+    }
+    size_t largest = 0;
+    for (size_t b = 0; b < set.bucket_count(); b++) {
+        largest = std::max(largest, set.bucket_size(b));
+    }
+    CHECK(set.size() == 10000);
+    CHECK(largest < 10);
+}
+
+/*
+====================================================================================================
+  ~*~ HexTopology ~*~
+==================================================================================================*/
+TEST_CASE("Hex rings, spirals and lines.") {
+    constexpr HexCoords c = HexCoords::from_offset(4, -3);
+    static_assert(c.distance(hex::neighbour(c, 2)) == 1, "neighbours are one step away");
+    static_assert(c.distance(c + hex::direction(1) * 3 + hex::direction(5)) == 3, "distance");
+
+    for (int r = 0; r < 5; r++) {
+        std::unordered_set<HexCoords> ring;
+        for (auto h : Ring(c, r)) {
+            CHECK(h.distance(c) == r);
+            ring.insert(h);
+        }
+        CHECK(int(ring.size()) == Ring(c, r).size());
+    }
+
+    std::unordered_set<HexCoords> spiral;
+    int previous = 0;
+    for (auto h : Spiral(c, 4)) {
+        CHECK(h.distance(c) >= previous);
+        previous = h.distance(c);
+        spiral.insert(h);
+    }
+    CHECK(spiral.size() == 61);
+
+    for (auto n : Neighbours(c)) {
+        CHECK(spiral.count(n) == 1);
+    }
+
+    auto to = HexCoords::from_offset(-7, 12);
+    Line line(c, to);
+    CHECK(line.size() == c.distance(to) + 1);
+    HexCoords last = c;
+    for (auto h : line) {
+        CHECK(h.distance(last) <= 1);
+        last = h;
+    }
+    CHECK(last == to);
+}
+
+/*
+====================================================================================================
+  ~*~ HexBatch ~*~
+==================================================================================================*/
+TEST_CASE("HexBatch conversions match HexCoords.") {
+    vector<simd::Level> levels{simd::Level::scalar, simd::Level::vector4};
+    if (simd::best_level() == simd::Level::vector8) {
+        levels.push_back(simd::Level::vector8);
+    }
+    float w = 144;
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-5000, 5000);
+    vector<vec> pixels;
+    vector<HexCoords> hexes;
+    for (int i = 0; i < 1001; i++) {
+        pixels.emplace_back(dist(gen), dist(gen));
+        hexes.push_back(HexCoords::from_pixel(w, pixels.back()));
+    }
+    for (int i = 0; i < 6; i++) {  // corners of a hex, where rounding is a tie
+        pixels.push_back(vec(0, 0) + vec(w * hex::inv_sqrt3 * cos(i * M_PI / 3 - M_PI / 2),
+                                         w * hex::inv_sqrt3 * sin(i * M_PI / 3 - M_PI / 2)));
+        hexes.push_back(HexCoords::from_offset(i - 3, 2 * i - 5));
+    }
+
+    for (auto level : levels) {
+        vector<HexCoords> from(pixels.size());
+        hex_batch::from_pixels(w, pixels.data(), pixels.size(), from.data(), level);
+        vector<vec> to(hexes.size());
+        hex_batch::to_pixels(w, hexes.data(), hexes.size(), to.data(), level);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            CHECK(from[i] == HexCoords::from_pixel(w, pixels[i]));
+            CHECK(to[i] == hexes[i].get_pixel(w));
+            CHECK(HexCoords::from_pixel(w, to[i]) == hexes[i]);
+        }
+    }
+}
+
+/*
+====================================================================================================
+  ~*~ OffsetRect ~*~
+==================================================================================================*/
+TEST_CASE("ViewDiff strips cover exactly what entered and exited.") {
+    ViewDiff diff;
+    diff.previous = OffsetRect(ivec(0, 0), ivec(9, 7));
+    diff.current = OffsetRect(ivec(2, -1), ivec(11, 6));  // panned right and up
+    CHECK(diff.changed());
+
+    std::set<std::pair<int, int>> entered, exited;
+    for (auto& rect : diff.entered()) {
+        for (auto c : rect) {
+            CHECK(entered.insert({c.get_offset().x, c.get_offset().y}).second);  // disjoint
+        }
+    }
+    for (auto& rect : diff.exited()) {
+        for (auto c : rect) {
+            exited.insert({c.get_offset().x, c.get_offset().y});
+        }
+    }
+    for (int x = -2; x < 14; x++) {
+        for (int y = -3; y < 10; y++) {
+            bool now = diff.current.contains(ivec(x, y));
+            bool before = diff.previous.contains(ivec(x, y));
+            CHECK(entered.count({x, y}) == (now and !before));
+            CHECK(exited.count({x, y}) == (before and !now));
+        }
+    }
+    CHECK(diff.entered().size() == int(entered.size()));
+
+    diff.previous = diff.current;
+    CHECK(!diff.changed());
+    CHECK(diff.entered().size() == 0);
+}
+
+/*
+====================================================================================================
+  ~*~ TerrainArray ~*~
+==================================================================================================*/
+TEST_CASE("TerrainArray indexing and iteration.") {
+    TerrainArray terrain(ivec(-3, 5), ivec(2, 9));
+    CHECK(terrain.size() == 20);
+
+    size_t i = 0;
+    for (auto&& tile : terrain) {
+        CHECK(terrain.index(tile.first) == i);
+        CHECK(terrain.coords(i) == tile.first);
+        tile.second = TileData(i % 7, i % 2);
+        i++;
+    }
+    CHECK(i == 20);
+
+    auto coords = HexCoords::from_offset(-1, 7);
+    CHECK(terrain.contains(coords));
+    CHECK(!terrain.contains(HexCoords::from_offset(2, 7)));
+    CHECK(!terrain.contains(HexCoords::from_offset(-4, 7)));
+    CHECK(terrain.at(coords) == terrain[12]);
+}
+
+/*
+====================================================================================================
+  ~*~ CellState serialization ~*~
+==================================================================================================*/
+TEST_CASE("CellState binary round trip.") {
+    CellState state(HexCoords::from_offset(-20, 40), HexCoords::from_offset(0, 60));
+    string data;
+    state.encode(data);
+    CHECK(data.size() == CellState::header_size + 2 * 400);
+    REQUIRE(CellState::check(data.data(), data.size()));
+    CHECK(!CellState::check(data.data(), data.size() - 1));
+
+    CellState decoded(data.data());
+    CHECK(decoded.get_map().get_tl() == ivec(-20, 40));
+    for (auto&& tile : state.get_map()) {
+        CHECK(decoded.get_terrain_at(tile.first) == tile.second);
+    }
+
+    std::stringstream ss;
+    CellState streamed;
+    ss << state;
+    ss >> streamed;
+    CHECK(ss);
+    string data2;
+    streamed.encode(data2);
+    CHECK(data == data2);
+
+    std::stringstream garbage("not a cell at all");
+    garbage >> streamed;
+    CHECK(garbage.fail());
+}
+
+/*
+====================================================================================================
+  ~*~ CellStore ~*~
+==================================================================================================*/
+TEST_CASE("CellStore reads back cells from region files.") {
+    char directory[] = "/tmp/menhyr_test_XXXXXX";
+    REQUIRE(mkdtemp(directory) != nullptr);
+
+    auto read = [](CellStore& store, ivec coords) {
+        string result;
+        store.read(coords, [&](const char* data, size_t size) { result.assign(data, size); });
+        return result;
+    };
+
+    {
+        CellStore store(directory);
+        store.save(ivec(-1, 3), "first");
+        CHECK(read(store, ivec(-1, 3)) == "first");  // before flush
+        CHECK(store.flush(ivec(-1, 3)));
+        store.save(ivec(31, -32), "second");
+        store.save(ivec(-1, 3), "much longer first");
+        CHECK(read(store, ivec(5, 5)) == "");
+        struct stat st;  // a miss does not create the region file
+        CHECK(stat(CellStore::region_path(directory, ivec(0, 0)).c_str(), &st) != 0);
+    }  // flushes everything
+
+    CellStore store(directory, 1);
+    CHECK(read(store, ivec(-1, 3)) == "much longer first");
+    CHECK(read(store, ivec(31, -32)) == "second");
+    CHECK(store.get_nb_open_regions() == 1);  // the least recently used one was closed
+    CHECK(read(store, ivec(-1, 3)) == "much longer first");
+
+    // rewrites are appended, even when they would fit in place
+    {
+        RegionFile file(CellStore::region_path(directory, ivec(-1, 0)));
+        size_t size = file.get_file_size();
+        REQUIRE(file.write(ivec(-1, 3), "short"));
+        CHECK(file.get_file_size() == size + 5);
+    }
+    CellStore reopened(directory);
+    CHECK(read(reopened, ivec(-1, 3)) == "short");
+    CHECK(RegionFile::region_of(ivec(-1, 3)) == ivec(-1, 0));
+    CHECK(RegionFile::region_of(ivec(31, -32)) == ivec(0, -1));
+
+    for (auto r : {ivec(-1, 0), ivec(0, -1)}) {
+        CHECK(remove(CellStore::region_path(directory, r).c_str()) == 0);
+    }
+    CHECK(rmdir(directory) == 0);
+}
+
+/*
+====================================================================================================
+  ~*~ TerrainGenerator ~*~
+==================================================================================================*/
+TEST_CASE("TerrainGenerator is a pure function of seed and coordinates.") {
+    TerrainGenerator gen(42), same(42), other(43);
+
+    // cells generated in any order or from any origin agree on their common tiles
+    CellState a(HexCoords::from_offset(0, 0), HexCoords::from_offset(20, 20), gen);
+    CellState b(HexCoords::from_offset(-10, 10), HexCoords::from_offset(10, 30), same);
+    int nb_common = 0, nb_forests = 0, nb_different = 0;
+    for (auto&& tile : a.get_map()) {
+        CHECK(tile.second.first < TerrainGenerator::nb_soil_types);
+        if (b.get_map().contains(tile.first)) {
+            CHECK(b.get_terrain_at(tile.first) == tile.second);
+            nb_common++;
+        }
+        nb_forests += tile.second.second == 0;
+        nb_different += other.tile(tile.first) != tile.second;
+    }
+    CHECK(nb_common == 100);
+    CHECK(nb_forests > 50);
+    CHECK(nb_forests < 350);
+    CHECK(nb_different > 0);
+}
+
+TEST_CASE("TerrainGenerator batch kernels match the scalar path.") {
+    vector<simd::Level> levels{simd::Level::scalar, simd::Level::vector4};
+    if (simd::best_level() == simd::Level::vector8) {
+        levels.push_back(simd::Level::vector8);
+    }
+    for (uint32_t seed : {0u, 1u, 123456789u}) {
+        TerrainGenerator gen(seed);
+        for (int y : {-1001, -2, 0, 7, 40000}) {
+            int x0 = -37, count = 77;  // not a multiple of any width
+            for (auto level : levels) {
+                vector<TileData> row(count);
+                gen.fill_row(x0, y, count, row.data(), level);
+                for (int i = 0; i < count; i++) {
+                    CHECK(row[i] == gen.tile(x0 + i, y));
+                }
+            }
+        }
+    }
+}
+
+/*
+====================================================================================================
+  ~*~ Pathfinder ~*~
+==================================================================================================*/
+TEST_CASE("Pathfinder goes around walls and through cheap tiles.") {
+    // plain soil, a wall (soil type 1) at x = 0 from y = -6 to 6, forests at x = 5
+    struct Walled : TerrainSource {
+        TileData terrain_at(const HexCoords& coords) const override {
+            ivec o = coords.get_offset();
+            return TileData(o.x == 0 and abs(o.y) <= 6 ? 1 : 0, o.x == 5 ? 0 : 1);
+        }
+    } terrain;
+
+    Pathfinder pathfinder;
+    pathfinder.set_terrain(&terrain);
+    pathfinder.set_soil_cost(1, std::numeric_limits<scalar>::infinity());
+
+    vector<HexCoords> path;
+    auto from = HexCoords::from_offset(-3, 0), to = HexCoords::from_offset(3, 0);
+    REQUIRE(pathfinder.find_path(from, to, path));
+    CHECK(path.front() == from);
+    CHECK(path.back() == to);
+    for (size_t i = 1; i < path.size(); i++) {
+        CHECK(path[i].distance(path[i - 1]) == 1);
+        CHECK(terrain.terrain_at(path[i]).first == 0);
+    }
+    CHECK(int(path.size()) > from.distance(to) + 1);
+
+    // forests are slower but passable
+    auto west = HexCoords::from_offset(3, 2), east = HexCoords::from_offset(7, 2);
+    REQUIRE(pathfinder.find_path(west, east, path));
+    CHECK(int(path.size()) == west.distance(east) + 1);
+
+    // a wall that cannot be walked around within the margin
+    pathfinder.set_margin(2);
+    CHECK(!pathfinder.find_path(from, to, path));
+    CHECK(path.empty());
+
+    auto& stats = pathfinder.get_stats();
+    CHECK(stats.queries == 3);
+    CHECK(stats.failures == 1);
+    CHECK(stats.expanded > 0);
+
+    // following a flow field costs as much as the shortest path, from anywhere
+    pathfinder.set_margin(8);
+    FlowField field;
+    OffsetRect area(ivec(-10, -10), ivec(10, 10));
+    REQUIRE(pathfinder.build_flow_field(to, area, field));
+    CHECK(field.next_step(to) == to);
+    CHECK(field.next_step(HexCoords::from_offset(20, 0)) == HexCoords::from_offset(20, 0));
+    for (auto start : {from, HexCoords::from_offset(-9, -9), HexCoords::from_offset(8, 10)}) {
+        REQUIRE(pathfinder.find_path(start, to, path));
+        scalar path_cost = 0;
+        for (size_t i = 1; i < path.size(); i++) {
+            path_cost += pathfinder.step_cost(terrain.terrain_at(path[i]));
+        }
+        scalar field_cost = 0;
+        for (auto h = start; h != to; h = field.next_step(h)) {
+            REQUIRE(field.next_step(h).distance(h) == 1);
+            field_cost += pathfinder.step_cost(terrain.terrain_at(field.next_step(h)));
+        }
+        CHECK(field_cost == path_cost);
+        CHECK(field.cost_to_target(start) == path_cost);
+    }
+
+    // the same field, swept a few nodes at a time
+    FlowField resumed;
+    REQUIRE(pathfinder.start_flow_field(to, area, resumed));
+    CHECK(!pathfinder.extend_flow_field(resumed, 0));
+    CHECK(!resumed.is_complete());
+    while (!pathfinder.extend_flow_field(resumed, 0.01)) {
+    }
+    for (auto h : area) {
+        CHECK(resumed.cost_to_target(h) == field.cost_to_target(h));
+    }
+    CHECK(stats.flow_fields == 2);
+
+    // a search spread over several calls finds the same path
+    REQUIRE(pathfinder.find_path(from, to, path));
+    vector<HexCoords> resumed_path;
+    REQUIRE(pathfinder.start_path(from, to));
+    CHECK(pathfinder.extend_path(resumed_path, 0) == PathStatus::searching);
+    PathStatus status;
+    while ((status = pathfinder.extend_path(resumed_path, 0.01)) == PathStatus::searching) {
+    }
+    CHECK(status == PathStatus::found);
+    CHECK(resumed_path == path);
+    CHECK(!pathfinder.is_searching());
+}
+